@@ -0,0 +1,77 @@
+#! /usr/bin/env python3
+# SPDX-License-Identifier: BSL-1.0
+
+# Converts the range tables from charclassification*.inc into two level lookup tables.
+#
+# usage: charwidthtrie.py outfile name1 infile1 [name2 infile2 ...]
+#
+# Widths are stored with 2 bits per codepoint (3 meaning -1 like in the range tables) in blocks of 256 codepoints.
+# Blocks are shared between all tables, the index for table "name" maps codepoint >> 8 to the block.
+
+import re
+import sys
+
+CODEPOINTS = 0x110000
+BLOCK_SIZE = 256
+
+outfile = sys.argv[1]
+tables = list(zip(sys.argv[2::2], sys.argv[3::2]))
+
+def read_widths(infile):
+    base = None
+    ranges = []
+    entries = 0
+    with open(infile) as f:
+        for line in f:
+            entries += 'NEW_WIDTH(' in line
+            m = re.match(r'\s*// U\+([0-9a-fA-F]+),', line)
+            if m:
+                base = int(m.group(1), 16)
+                continue
+            m = re.match(r'\s*NEW_WIDTH\((0x[0-9a-fA-F]+), (-1|[0-2])\)', line)
+            if m:
+                ranges.append((base + int(m.group(1), 16), int(m.group(2)) & 3))
+    if entries != len(ranges):
+        sys.exit('charwidthtrie.py: could not parse all entries of ' + infile)
+
+    widths = bytearray(CODEPOINTS)
+    for i, (start, width) in enumerate(ranges):
+        end = ranges[i + 1][0] if i + 1 < len(ranges) else CODEPOINTS
+        widths[start:end] = bytes([width]) * (end - start)
+    return widths
+
+blocks = []
+block_ids = {}
+indices = []
+
+for name, infile in tables:
+    widths = read_widths(infile)
+    index = []
+    for start in range(0, CODEPOINTS, BLOCK_SIZE):
+        block = bytes(widths[start:start + BLOCK_SIZE])
+        if block not in block_ids:
+            block_ids[block] = len(blocks)
+            blocks.append(block)
+        index.append(block_ids[block])
+    indices.append((name, index))
+
+if len(blocks) > 256:
+    sys.exit('charwidthtrie.py: too many distinct blocks for 8 bit index')
+
+def write_array(f, values):
+    for i in range(0, len(values), 16):
+        f.write('    ' + ' '.join('0x{:02x},'.format(v) for v in values[i:i + 16]) + '\n')
+
+with open(outfile, 'w') as f:
+    f.write('// generated by charwidthtrie.py, do not edit\n\n')
+    packed = []
+    for block in blocks:
+        for i in range(0, BLOCK_SIZE, 4):
+            packed.append(block[i] | block[i + 1] << 2 | block[i + 2] << 4 | block[i + 3] << 6)
+    f.write('static const uint8_t termpaint_char_width_blocks[0x{:x}] = {{\n'.format(len(packed)))
+    write_array(f, packed)
+    f.write('};\n')
+    for name, index in indices:
+        f.write('\nstatic const uint8_t termpaint_char_width_index_{}[0x{:x}] = {{\n'.format(name, len(index)))
+        write_array(f, index)
+        f.write('};\n')
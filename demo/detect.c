@@ -32,6 +32,9 @@ Cap caps[] = {
     C(7BIT_ST, "7bit-st"),
     C(MAY_TRY_TAGGED_PASTE, "taggedpaste"),
     C(CLEARED_COLORING_DEFCOLOR, "clrcoldef"),
+    C(SCROLL_REGION, "scrollreg"),
+    C(REPEAT_CHAR, "rep"),
+    C(SYNCHRONIZED_UPDATE, "syncupd"),
 #undef C
     { 0, NULL, 0 }
 };
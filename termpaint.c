@@ -2,6 +2,7 @@
 #include "termpaint.h"
 
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -9,6 +10,10 @@
 #include <stdint.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "termpaint_compiler.h"
 #include "termpaint_input.h"
 #include "termpaint_utf8.h"
@@ -72,7 +77,8 @@ typedef unsigned char uchar;
  * - foreground color (default or 16 colors (named or bright named)
  *   or 256 color or direct color)
  * - background color (same options as foreground color)
- * - patch (an beginning and ending string of control sequences; 0 no patch else index + 1 of patches array in surface)
+ * - patch (an beginning and ending string of control sequences; 0 no patch else index + 1 into the patch table of
+ *   the surface)
  *
  * text_len == 0 && text_overflow == nullptr -> same as ' '
  * text_len == 0 && text_overflow == WIDE_RIGHT_PADDING -> character hidden by multi cell cluster
@@ -93,6 +99,9 @@ struct termpaint_attr_ {
     bool patch_optimize;
     unsigned char* patch_setup;
     unsigned char* patch_cleanup;
+    // Identifies the current patch for termpaintp_surface_attr_patch_idx, unique per call to set_patch. 0 if no
+    // patch is active.
+    uint64_t patch_serial;
 };
 
 #define CELL_ATTR_BOLD (1 << 0)
@@ -105,11 +114,11 @@ struct termpaint_attr_ {
 #define CELL_ATTR_OVERLINE (1 << 5)
 #define CELL_ATTR_INVERSE (1 << 6)
 #define CELL_ATTR_STRIKE (1 << 7)
+#define CELL_ATTR_MASK ((uint16_t)0xff)
 
 #define CELL_ATTR_DECO_MASK CELL_ATTR_UNDERLINE_MASK
 
-#define CELL_SOFTWRAP_MARKER (1 << 15)
-#define CELL_ATTR_MASK ((uint16_t)(~CELL_SOFTWRAP_MARKER))
+#define CELL_SOFTWRAP_MARKER (1 << 0)
 
 #define TERMPAINT_STYLE_PASSTHROUGH (TERMPAINT_STYLE_BOLD | TERMPAINT_STYLE_ITALIC | TERMPAINT_STYLE_BLINK \
     | TERMPAINT_STYLE_OVERLINE | TERMPAINT_STYLE_INVERSE | TERMPAINT_STYLE_STRIKE)
@@ -117,46 +126,121 @@ struct termpaint_attr_ {
 #define WIDE_RIGHT_PADDING ((termpaint_hash_item*)-1)
 
 typedef struct cell_ {
-    uint32_t fg_color;
-    uint32_t bg_color;
-    uint32_t deco_color;
-    uint16_t flags; // bold, italic, underline[2], blinking, overline, inverse, strikethrough. softwrap marker
-    uint8_t attr_patch_idx;
+    uint32_t attr_id; // index into the attribute table of the surface
+    uint8_t flags; // softwrap marker
 
     uint8_t cluster_expansion : 4;
     uint8_t text_len : 4; // == 0 -> text_overflow is active or WIDE_RIGHT_PADDING.
+    uint16_t reserved; // always 0, cells are compared bitwise and must not contain padding
     union {
         termpaint_hash_item* text_overflow;
         unsigned char text[8];
     };
 } cell;
 
-_Static_assert(sizeof(void*) > 8 || sizeof(cell) == 24, "bad cell size");
+_Static_assert(sizeof(void*) > 8 || sizeof(cell) == 16, "bad cell size");
+
+#define ATTR_ID_NONE UINT32_MAX
+
+// A distinct combination of colors, style and patch. Surfaces intern these in their attribute table, so cells only
+// need to store the id of the entry.
+typedef struct termpaintp_attr_entry_ {
+    uint32_t fg_color;
+    uint32_t bg_color;
+    uint32_t deco_color;
+    uint32_t patch_idx;
+    uint16_t flags; // bold, italic, underline[2], blinking, overline, inverse, strikethrough
+
+    bool used; // false for free entries, also used as mark while collecting garbage
+    uint32_t next; // next entry in the same hash bucket or in the free list
+    // Only for the primary surface: id of the entry with the colors as sent to the terminal (quantized and deco color
+    // only when relevant) or ATTR_ID_NONE if not yet known.
+    uint32_t quantized_id;
+} termpaintp_attr_entry;
+
+// Id 0 is always the default attributes, so that zero initialized cells are valid.
+typedef struct termpaintp_attr_table_ {
+    termpaintp_attr_entry *entries;
+    uint32_t *buckets; // allocated entries, power of 2
+    unsigned allocated;
+    unsigned used; // entries at or above this index were never used
+    uint32_t free_list;
+    // Incremented by every garbage collection. Ids not referenced by any cell are only valid within one generation.
+    unsigned generation;
+} termpaintp_attr_table;
+
+#define PATCH_ID_NONE UINT32_MAX
 
 typedef struct termpaintp_patch_ {
     bool optimize;
 
     uint32_t setup_hash;
-    unsigned char *setup;
+    unsigned char *setup; // nullptr for free entries
 
     uint32_t cleanup_hash;
     unsigned char *cleanup;
 
-    bool unused;
+    uint32_t refcount; // number of entries in the attribute table using this patch
+    uint32_t next; // next entry in the same hash bucket or in the free list
 } termpaintp_patch;
 
+// Patches are referenced from attribute table entries by index + 1. A patch is freed when the last entry using it
+// is collected, see termpaintp_surface_attrs_gc. Adding a patch to a full table collects first.
+typedef struct termpaintp_patch_table_ {
+    termpaintp_patch *entries;
+    uint32_t *buckets; // allocated entries, power of 2
+    unsigned allocated;
+    unsigned used; // entries at or above this index were never used
+    uint32_t free_list;
+} termpaintp_patch_table;
+
+// Remembers which patch index a surface uses for a termpaint_attr's patch. Valid as long as the generation of the
+// attribute table matches, as patches are only freed after garbage collecting the attribute table.
+typedef struct termpaintp_patch_cache_entry_ {
+    uint64_t serial;
+    unsigned generation;
+    uint32_t patch_idx;
+} termpaintp_patch_cache_entry;
+
+#define TERMPAINTP_PATCH_CACHE_SIZE 16
+
+// Range of cells in a row that might have changed since the last flush.
+// x1 < x0 means the row is unchanged.
+typedef struct termpaintp_row_damage_ {
+    int x0;
+    int x1; // inclusive
+} termpaintp_row_damage;
+
 struct termpaint_surface_ {
     termpaint_terminal *terminal;
 
     bool primary;
     cell* cells;
     cell* cells_last_flush;
+    termpaintp_row_damage* row_damage; // only for primary, one entry per row
+    termpaintp_row_damage* tracked_damage; // one entry per row while damage tracking is enabled
     unsigned cells_allocated;
     int width;
     int height;
 
     termpaint_hash overflow_text;
-    termpaintp_patch *patches;
+    termpaintp_patch_table patches;
+    termpaintp_attr_table attrs;
+    termpaintp_patch_cache_entry patch_cache[TERMPAINTP_PATCH_CACHE_SIZE];
+
+    // A view has no storage of its own, it maps the rectangle at view_x, view_y of view_parent. width and height
+    // are view_width and view_height clipped to the parent.
+    // A copy-on-write duplicate is a view of the whole parent until either side is changed, see
+    // termpaintp_surface_prepare_write.
+    termpaint_surface *view_parent;
+    bool cow_duplicate;
+    termpaint_surface *first_view; // list of views of this surface, linked by next_view
+    termpaint_surface *first_cow_duplicate; // list of copy-on-write duplicates of this surface, linked by next_view
+    termpaint_surface *next_view;
+    int view_x;
+    int view_y;
+    int view_width;
+    int view_height;
 };
 
 typedef enum auto_detect_state_ {
@@ -261,9 +345,36 @@ typedef struct termpaint_integration_private_ {
     void (*awaiting_response)(struct termpaint_integration_ *integration);
     void (*restore_sequence_updated)(struct termpaint_integration_ *integration, const char *data, int length);
     void (*logging_func)(struct termpaint_integration_ *integration, const char *data, int length);
+    size_t bytes_written; // total of all writes, used for the flush byte budget
 } termpaint_integration_private;
 
-#define NUM_CAPABILITIES 16
+#define NUM_CAPABILITIES 19
+
+#define QUANTIZE_CACHE_SIZE 256
+
+// worst case is about 100 bytes with all colors in rgb and all attributes set
+#define SGR_MAX_LEN 128
+#define SGR_CACHE_SETS 32
+#define SGR_CACHE_WAYS 4
+
+typedef struct termpaintp_sgr_buffer_ {
+    char data[SGR_MAX_LEN];
+    int len;
+} termpaintp_sgr_buffer;
+
+typedef struct termpaintp_sgr_cache_entry_ {
+    uint32_t bg;
+    uint32_t fg;
+    uint32_t deco;
+    uint16_t flags;
+    uint32_t last_used; // 0 for unused entries
+    termpaintp_sgr_buffer sgr;
+} termpaintp_sgr_cache_entry;
+
+typedef struct termpaintp_quantize_cache_entry_ {
+    uint32_t color; // 0 (TERMPAINT_DEFAULT_COLOR) for unused entries, as only rgb colors are cached
+    uint32_t quantized;
+} termpaintp_quantize_cache_entry;
 
 typedef struct termpaint_terminal_ {
     termpaint_integration *integration;
@@ -271,6 +382,13 @@ typedef struct termpaint_terminal_ {
     termpaint_surface primary;
     termpaint_input *input;
     bool force_full_repaint;
+    bool quantization_changed; // colors in primary.cells_last_flush might be quantized for other capabilities
+    bool sgr_delta_encoding;
+    bool swap_buffers;
+    bool cells_last_flush_raw; // primary.cells_last_flush is a plain copy of primary.cells, colors are not quantized
+    bool last_flush_partial;
+    int flush_budget; // 0 = unlimited
+    int flush_resume_row; // first row for the next flush after a partial flush
     bool data_pending_after_input_received : 1;
     bool request_repaint : 1;
     termpaint_str auto_detect_sec_device_attributes;
@@ -323,6 +441,10 @@ typedef struct termpaint_terminal_ {
     auto_detect_state glitch_patching_next_state;
     // </>
     bool capabilities[NUM_CAPABILITIES];
+    termpaintp_quantize_cache_entry quantize_cache[QUANTIZE_CACHE_SIZE];
+    // finished sgr sequences for recently used attributes, SGR_CACHE_WAYS way set associative with lru eviction
+    termpaintp_sgr_cache_entry sgr_cache[SGR_CACHE_SETS * SGR_CACHE_WAYS];
+    uint32_t sgr_cache_tick;
     int max_csi_parameters;
 } termpaint_terminal;
 
@@ -661,19 +783,425 @@ void termpaint_integration_deinit(termpaint_integration *integration) {
     integration->p = nullptr;
 }
 
+static void termpaintp_view_clip(termpaint_surface *view) {
+    const termpaint_surface *parent = view->view_parent;
+    view->width = parent->width - view->view_x < view->view_width ? parent->width - view->view_x : view->view_width;
+    view->height = parent->height - view->view_y < view->view_height ? parent->height - view->view_y : view->view_height;
+    if (view->width <= 0 || view->height <= 0) {
+        view->width = 0;
+        view->height = 0;
+    }
+}
+
+// Maps a position in a view to the same cell in the surface owning the cells. Returns false if the position is
+// outside of the view. Surfaces that are not views are passed through unchanged.
+static inline bool termpaintp_view_translate(const termpaint_surface **surface, int *x, int *y) {
+    const termpaint_surface *view = *surface;
+    if (!view->view_parent) {
+        return true;
+    }
+    if (*x < 0 || *y < 0 || *x >= view->width || *y >= view->height) {
+        return false;
+    }
+    *x += view->view_x;
+    *y += view->view_y;
+    *surface = view->view_parent;
+    return true;
+}
+
 static void termpaintp_collapse(termpaint_surface *surface) {
     surface->width = 0;
     surface->height = 0;
     surface->cells_allocated = 0;
     surface->cells = nullptr;
     surface->cells_last_flush = nullptr;
+    surface->row_damage = nullptr;
+    for (termpaint_surface *view = surface->first_view; view; view = view->next_view) {
+        termpaintp_view_clip(view);
+    }
+}
+
+static void termpaintp_surface_reset_damage(termpaint_surface *surface) {
+    if (!surface->row_damage) {
+        return;
+    }
+    for (int y = 0; y < surface->height; y++) {
+        surface->row_damage[y].x0 = surface->width;
+        surface->row_damage[y].x1 = -1;
+    }
+}
+
+static inline void termpaintp_row_damage_add(termpaintp_row_damage *damage, int width, int x0, int x1) {
+    if (x0 < damage->x0) {
+        damage->x0 = x0 < 0 ? 0 : x0;
+    }
+    if (x1 > damage->x1) {
+        damage->x1 = x1 >= width ? width - 1 : x1;
+    }
+}
+
+// Marks cells to be repainted by the next flush.
+static inline void termpaintp_surface_damage(termpaint_surface *surface, int y, int x0, int x1) {
+    // narrow contract: 0 <= y < height, x0 and x1 are clamped here
+    if (!surface->row_damage) {
+        return;
+    }
+    termpaintp_row_damage_add(&surface->row_damage[y], surface->width, x0, x1);
+}
+
+// Marks cells whose contents changed, for the next flush and for damage tracking.
+static inline void termpaintp_surface_changed(termpaint_surface *surface, int y, int x0, int x1) {
+    // narrow contract: 0 <= y < height, x0 and x1 are clamped here
+    termpaintp_surface_damage(surface, y, x0, x1);
+    if (surface->tracked_damage) {
+        termpaintp_row_damage_add(&surface->tracked_damage[y], surface->width, x0, x1);
+    }
+}
+
+static void termpaintp_surface_damage_all(termpaint_surface *surface) {
+    if (!surface->row_damage) {
+        return;
+    }
+    for (int y = 0; y < surface->height; y++) {
+        surface->row_damage[y].x0 = 0;
+        surface->row_damage[y].x1 = surface->width - 1;
+    }
+}
+
+static inline const termpaintp_attr_entry *termpaintp_cell_attr(const termpaint_surface *surface, const cell *c) {
+    return &surface->attrs.entries[c->attr_id];
+}
+
+static inline termpaintp_attr_entry termpaintp_attr_make(uint32_t fg_color, uint32_t bg_color, uint32_t deco_color,
+                                                         uint16_t flags, uint32_t patch_idx) {
+    termpaintp_attr_entry attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.fg_color = fg_color;
+    attr.bg_color = bg_color;
+    attr.deco_color = deco_color;
+    attr.flags = flags;
+    attr.patch_idx = patch_idx;
+    return attr;
+}
+
+static inline uint32_t termpaintp_attr_hash(const termpaintp_attr_entry *attr) {
+    uint32_t hash = (attr->fg_color * 0x9e3779b1u) ^ (attr->bg_color * 0x85ebca77u)
+            ^ (attr->deco_color * 0xc2b2ae3du) ^ (attr->flags * 0x27d4eb2fu) ^ (attr->patch_idx * 0x165667b1u);
+    return hash ^ (hash >> 15);
+}
+
+static inline bool termpaintp_attr_equal(const termpaintp_attr_entry *a, const termpaintp_attr_entry *b) {
+    return a->fg_color == b->fg_color && a->bg_color == b->bg_color && a->deco_color == b->deco_color
+            && a->flags == b->flags && a->patch_idx == b->patch_idx;
+}
+
+// Recreates hash buckets and free list from the used markers. Returns the number of free entries.
+static unsigned termpaintp_attr_table_rebuild(termpaintp_attr_table *table) {
+    const uint32_t mask = table->allocated - 1;
+    for (unsigned i = 0; i < table->allocated; i++) {
+        table->buckets[i] = ATTR_ID_NONE;
+    }
+    unsigned free_entries = table->allocated - table->used;
+    table->free_list = ATTR_ID_NONE;
+    // backwards, so that the free list hands out low ids first
+    for (unsigned i = table->used; i-- > 0;) {
+        termpaintp_attr_entry *entry = &table->entries[i];
+        if (entry->used) {
+            uint32_t *bucket = &table->buckets[termpaintp_attr_hash(entry) & mask];
+            entry->next = *bucket;
+            *bucket = i;
+        } else {
+            entry->next = table->free_list;
+            table->free_list = i;
+            ++free_entries;
+        }
+    }
+    return free_entries;
+}
+
+static bool termpaintp_attr_table_init(termpaintp_attr_table *table) {
+    table->entries = calloc(16, sizeof(termpaintp_attr_entry));
+    table->buckets = calloc(16, sizeof(uint32_t));
+    if (!table->entries || !table->buckets) {
+        free(table->entries);
+        free(table->buckets);
+        table->entries = nullptr;
+        table->buckets = nullptr;
+        return false;
+    }
+    table->allocated = 16;
+    table->used = 1;
+    // all colors TERMPAINT_DEFAULT_COLOR, no style and no patch
+    table->entries[0].used = true;
+    table->entries[0].quantized_id = ATTR_ID_NONE;
+    termpaintp_attr_table_rebuild(table);
+    return true;
+}
+
+static void termpaintp_attr_table_destroy(termpaintp_attr_table *table) {
+    free(table->entries);
+    free(table->buckets);
+    table->entries = nullptr;
+    table->buckets = nullptr;
+    table->allocated = 0;
+    table->used = 0;
+}
+
+static bool termpaintp_attr_table_grow(termpaintp_attr_table *table) {
+    const unsigned allocated = table->allocated * 2;
+    if (allocated > (1u << 26)) {
+        return false;
+    }
+    termpaintp_attr_entry *entries = realloc(table->entries, allocated * sizeof(termpaintp_attr_entry));
+    if (!entries) {
+        return false;
+    }
+    table->entries = entries;
+    uint32_t *buckets = realloc(table->buckets, allocated * sizeof(uint32_t));
+    if (!buckets) {
+        return false;
+    }
+    table->buckets = buckets;
+    table->allocated = allocated;
+    termpaintp_attr_table_rebuild(table);
+    return true;
+}
+
+static void termpaintp_attr_table_forget_quantized(termpaintp_attr_table *table) {
+    for (unsigned i = 0; i < table->used; i++) {
+        table->entries[i].quantized_id = ATTR_ID_NONE;
+    }
+}
+
+static inline uint32_t termpaintp_patch_hash(uint32_t setup_hash, uint32_t cleanup_hash) {
+    uint32_t hash = setup_hash ^ (cleanup_hash * 0x9e3779b1u);
+    return hash ^ (hash >> 15);
+}
+
+// Recreates hash buckets and free list of the patch table from the entries.
+static void termpaintp_patch_table_rebuild(termpaintp_patch_table *table) {
+    const uint32_t mask = table->allocated - 1;
+    for (unsigned i = 0; i < table->allocated; i++) {
+        table->buckets[i] = PATCH_ID_NONE;
+    }
+    table->free_list = PATCH_ID_NONE;
+    for (unsigned i = table->used; i-- > 0;) {
+        termpaintp_patch *patch = &table->entries[i];
+        if (patch->setup) {
+            uint32_t *bucket = &table->buckets[termpaintp_patch_hash(patch->setup_hash, patch->cleanup_hash) & mask];
+            patch->next = *bucket;
+            *bucket = i;
+        } else {
+            patch->next = table->free_list;
+            table->free_list = i;
+        }
+    }
+}
+
+static bool termpaintp_patch_table_grow(termpaintp_patch_table *table) {
+    const unsigned allocated = table->allocated ? table->allocated * 2 : 16;
+    if (allocated > (1u << 24)) {
+        return false;
+    }
+    termpaintp_patch *entries = realloc(table->entries, allocated * sizeof(termpaintp_patch));
+    if (!entries) {
+        return false;
+    }
+    table->entries = entries;
+    uint32_t *buckets = realloc(table->buckets, allocated * sizeof(uint32_t));
+    if (!buckets) {
+        return false;
+    }
+    table->buckets = buckets;
+    table->allocated = allocated;
+    termpaintp_patch_table_rebuild(table);
+    return true;
+}
+
+static void termpaintp_patch_table_destroy(termpaintp_patch_table *table) {
+    for (unsigned i = 0; i < table->used; i++) {
+        free(table->entries[i].setup);
+        free(table->entries[i].cleanup);
+    }
+    free(table->entries);
+    free(table->buckets);
+    memset(table, 0, sizeof(*table));
+}
+
+// Drops a reference from an attribute table entry to the patch at patch_idx and frees the patch if it was the last.
+static void termpaintp_patch_table_release(termpaintp_patch_table *table, uint32_t patch_idx) {
+    const uint32_t id = patch_idx - 1;
+    termpaintp_patch *patch = &table->entries[id];
+    if (--patch->refcount) {
+        return;
+    }
+    uint32_t *link = &table->buckets[termpaintp_patch_hash(patch->setup_hash, patch->cleanup_hash)
+                                     & (table->allocated - 1)];
+    while (*link != id) {
+        link = &table->entries[*link].next;
+    }
+    *link = patch->next;
+    free(patch->setup);
+    free(patch->cleanup);
+    patch->setup = nullptr;
+    patch->cleanup = nullptr;
+    patch->next = table->free_list;
+    table->free_list = id;
+}
+
+// Both cell buffers are dense arrays of width * height cells. Scanning them linearly, one
+// buffer at a time, avoids the per cell bounds checks of termpaintp_getcell.
+static void termpaintp_cells_mark_used_attrs(termpaint_surface *surface, const cell *cells) {
+    const int count = surface->width * surface->height;
+    termpaintp_attr_entry *entries = surface->attrs.entries;
+    for (int i = 0; i < count; i++) {
+        entries[cells[i].attr_id].used = true;
+    }
+}
+
+// Frees all entries not used by any cell. Returns the number of free entries.
+static unsigned termpaintp_surface_attrs_gc(termpaint_surface *surface) {
+    termpaintp_attr_table *table = &surface->attrs;
+    if (!table->entries) {
+        return 0;
+    }
+    table->generation++;
+    for (unsigned i = 1; i < table->used; i++) {
+        table->entries[i].used = false;
+    }
+    termpaintp_cells_mark_used_attrs(surface, surface->cells);
+    if (surface->cells_last_flush) {
+        termpaintp_cells_mark_used_attrs(surface, surface->cells_last_flush);
+    }
+    // flush keeps quantized ids of used entries in local variables
+    for (unsigned i = 0; i < table->used; i++) {
+        const termpaintp_attr_entry *entry = &table->entries[i];
+        if (entry->used && entry->quantized_id != ATTR_ID_NONE) {
+            table->entries[entry->quantized_id].used = true;
+        }
+    }
+    // Free entries never reference a patch, so this only releases patches of entries that are collected now.
+    for (unsigned i = 1; i < table->used; i++) {
+        termpaintp_attr_entry *entry = &table->entries[i];
+        if (!entry->used && entry->patch_idx) {
+            termpaintp_patch_table_release(&surface->patches, entry->patch_idx);
+            entry->patch_idx = 0;
+        }
+    }
+    return termpaintp_attr_table_rebuild(table);
+}
+
+// Returns the id of the entry equal to attr in the attribute table of surface, adding it if needed. Adding can
+// collect unused entries, so afterwards ids that are not referenced by any cell of the surface might be reused.
+// attr must not point into the table.
+static uint32_t termpaintp_surface_intern_attr(termpaint_surface *surface, const termpaintp_attr_entry *attr) {
+    termpaintp_attr_table *table = &surface->attrs;
+    const uint32_t hash = termpaintp_attr_hash(attr);
+    for (uint32_t id = table->buckets[hash & (table->allocated - 1)]; id != ATTR_ID_NONE; id = table->entries[id].next) {
+        if (termpaintp_attr_equal(&table->entries[id], attr)) {
+            return id;
+        }
+    }
+
+    // The new entry counts as a user of its patch from here on, so collecting can not free the patch.
+    if (attr->patch_idx) {
+        surface->patches.entries[attr->patch_idx - 1].refcount++;
+    }
+
+    if (table->free_list == ATTR_ID_NONE && table->used == table->allocated) {
+        // Small tables just grow, larger tables first try to free unused entries.
+        unsigned free_entries = 0;
+        if (table->allocated >= 256) {
+            free_entries = termpaintp_surface_attrs_gc(surface);
+        }
+        if (free_entries < table->allocated / 4) {
+            if (!termpaintp_attr_table_grow(table) && free_entries == 0) {
+                if (!surface->terminal->glitch_on_oom) {
+                    termpaintp_oom(surface->terminal);
+                } else {
+                    termpaintp_oom_log_only(surface->terminal);
+                    if (attr->patch_idx) {
+                        termpaintp_patch_table_release(&surface->patches, attr->patch_idx);
+                        // the patch might be freed now, so cached patch indices are no longer valid
+                        table->generation++;
+                    }
+                    return 0;
+                }
+            }
+        }
+    }
+
+    uint32_t id;
+    if (table->free_list != ATTR_ID_NONE) {
+        id = table->free_list;
+        table->free_list = table->entries[id].next;
+    } else {
+        id = table->used++;
+    }
+    termpaintp_attr_entry *entry = &table->entries[id];
+    *entry = *attr;
+    entry->used = true;
+    entry->quantized_id = ATTR_ID_NONE;
+    uint32_t *bucket = &table->buckets[hash & (table->allocated - 1)];
+    entry->next = *bucket;
+    *bucket = id;
+    return id;
+}
+
+// Moves the contents of a buffer laid out for old_width x old_height cells into the layout of a width x height
+// surface. The overlapping region keeps its cells, everything else is zeroed (i.e. erased). dst may be the same
+// buffer as src, rows are then moved in an order that never overwrites cells that are still to be moved.
+static void termpaintp_cells_relayout(cell *dst, const cell *src, int old_width, int old_height,
+                                      int width, int height) {
+    const int copy_width = old_width < width ? old_width : width;
+    const int copy_height = old_height < height ? old_height : height;
+    const bool backwards = dst == src && width > old_width;
+    for (int i = 0; i < height; i++) {
+        const int y = backwards ? height - 1 - i : i;
+        cell *row = &dst[y * width];
+        if (y < copy_height && copy_width > 0) {
+            memmove(row, &src[y * old_width], copy_width * sizeof(cell));
+            memset(row + copy_width, 0, (width - copy_width) * sizeof(cell));
+        } else {
+            memset(row, 0, width * sizeof(cell));
+        }
+    }
+}
+
+// After cutting a row at the right edge a cluster might be left with only its leftmost cells. Such a cluster is
+// replaced by spaces that keep the cluster's attributes. Returns the first replaced cell or width if the row was
+// left unchanged.
+static int termpaintp_cells_fix_cut_cluster(cell *row, int width) {
+    int x = width - 1;
+    while (x > 0 && row[x].text_len == 0 && row[x].text_overflow == WIDE_RIGHT_PADDING) {
+        --x;
+    }
+    if (x + row[x].cluster_expansion < width) {
+        return width;
+    }
+    for (int i = x; i < width; i++) {
+        row[i].cluster_expansion = 0;
+        row[i].text_len = 1;
+        row[i].text[0] = ' ';
+    }
+    return x;
+}
+
+static bool termpaintp_cells_contain_softwrap(const cell *cells, int count) {
+    for (int i = 0; i < count; i++) {
+        if (cells[i].flags & CELL_SOFTWRAP_MARKER) {
+            return true;
+        }
+    }
+    return false;
 }
 
+static void termpaintp_terminal_quantize_last_flush(termpaint_terminal *term);
+
 static bool termpaintp_resize_mustcheck(termpaint_surface *surface, int width, int height) {
-    // TODO move contents along?
+    const int old_width = surface->width;
+    const int old_height = surface->height;
 
-    surface->width = width;
-    surface->height = height;
     _Static_assert(sizeof(int) <= sizeof(size_t), "int smaller than size_t");
     int bytes;
     int cell_count;
@@ -685,26 +1213,129 @@ static bool termpaintp_resize_mustcheck(termpaint_surface *surface, int width, i
         int_debuglog_printf(surface->terminal, "surface resize: Invalid size %dx%d, collapsing surface.", width, height);
         free(surface->cells);
         free(surface->cells_last_flush);
+        free(surface->row_damage);
         termpaintp_collapse(surface);
         return true; // This is debatable, but the previous code did allow this and there are tests for this.
     }
-    surface->cells_allocated = cell_count;
-    free(surface->cells);
-    free(surface->cells_last_flush);
-    surface->cells_last_flush = nullptr;
-    surface->cells = calloc(1, bytes);
-    if (!surface->cells) {
+
+    if (!surface->attrs.entries && !termpaintp_attr_table_init(&surface->attrs)) {
+        free(surface->cells);
+        free(surface->cells_last_flush);
+        free(surface->row_damage);
         termpaintp_collapse(surface);
         return false;
     }
 
+    // Interactive resizing produces long series of small size changes, keep the allocation as long as it fits and
+    // is not grossly oversized.
+    const bool reuse = surface->cells && (unsigned)cell_count <= surface->cells_allocated
+            && (unsigned)cell_count >= surface->cells_allocated / 4;
+
+    cell *cells = reuse ? surface->cells : calloc(1, bytes);
+    cell *cells_last_flush = nullptr;
+    termpaintp_row_damage *row_damage = nullptr;
     if (surface->primary) {
-        surface->terminal->force_full_repaint = true;
-        surface->cells_last_flush = calloc(1, surface->cells_allocated * sizeof(cell));
-        if (!surface->cells_last_flush) {
-            free(surface->cells);
-            termpaintp_collapse(surface);
-            return false;
+        cells_last_flush = reuse ? surface->cells_last_flush : calloc(1, bytes);
+        // height can be 0, allocate at least one entry to keep the pointer non null
+        row_damage = realloc(surface->row_damage, (height ? height : 1) * sizeof(termpaintp_row_damage));
+        if (row_damage) {
+            surface->row_damage = row_damage;
+        }
+    }
+    termpaintp_row_damage *tracked_damage = nullptr;
+    if (surface->tracked_damage) {
+        tracked_damage = realloc(surface->tracked_damage, (height ? height : 1) * sizeof(termpaintp_row_damage));
+        if (tracked_damage) {
+            surface->tracked_damage = tracked_damage;
+        }
+    }
+    if (!cells || (surface->primary && (!cells_last_flush || !row_damage))
+            || (surface->tracked_damage && !tracked_damage)) {
+        if (!reuse) {
+            free(cells);
+            free(cells_last_flush);
+        }
+        free(surface->cells);
+        free(surface->cells_last_flush);
+        free(surface->row_damage);
+        termpaintp_collapse(surface);
+        return false;
+    }
+
+    // A terminal is only expected to keep what it displays in place if it just got wider. When it changes height or
+    // gets narrower it might reflow or scroll, and softwrapped lines might be rewrapped by the terminal.
+    const bool keep_last_flush = surface->primary && height == old_height && width >= old_width
+            && !termpaintp_cells_contain_softwrap(surface->cells_last_flush, old_width * old_height);
+
+    if (surface->cells) {
+        termpaintp_cells_relayout(cells, surface->cells, old_width, old_height, width, height);
+        if (width < old_width) {
+            const int copy_height = old_height < height ? old_height : height;
+            for (int y = 0; y < copy_height && width > 0; y++) {
+                const int fixed = termpaintp_cells_fix_cut_cluster(&cells[y * width], width);
+                if (fixed < width && tracked_damage) {
+                    termpaintp_row_damage_add(&tracked_damage[y], width, fixed, width - 1);
+                }
+            }
+        }
+    }
+    if (surface->primary) {
+        if (keep_last_flush) {
+            termpaintp_cells_relayout(cells_last_flush, surface->cells_last_flush, old_width, old_height,
+                                      width, height);
+        } else if (reuse) {
+            memset(cells_last_flush, 0, bytes);
+        }
+    }
+
+    if (!reuse) {
+        free(surface->cells);
+        free(surface->cells_last_flush);
+        surface->cells_allocated = cell_count;
+    }
+    surface->cells = cells;
+    surface->cells_last_flush = cells_last_flush;
+    surface->width = width;
+    surface->height = height;
+    for (termpaint_surface *view = surface->first_view; view; view = view->next_view) {
+        termpaintp_view_clip(view);
+    }
+
+    if (tracked_damage) {
+        // Contents are preserved, so only cells outside of the old size are new.
+        for (int y = 0; y < height; y++) {
+            if (y >= old_height) {
+                tracked_damage[y].x0 = 0;
+                tracked_damage[y].x1 = width - 1;
+            } else if (tracked_damage[y].x1 >= width) {
+                tracked_damage[y].x1 = width - 1;
+            }
+            if (width > old_width) {
+                termpaintp_row_damage_add(&tracked_damage[y], width, old_width, width - 1);
+            }
+        }
+    }
+
+    if (surface->primary) {
+        if (keep_last_flush) {
+            // The marker cells below are not valid surface contents, so they must never be swapped into the surface.
+            if (surface->terminal->cells_last_flush_raw) {
+                termpaintp_terminal_quantize_last_flush(surface->terminal);
+            }
+            // Pending damage of the kept rows stays valid, the new columns were never painted.
+            for (int y = 0; y < height; y++) {
+                for (int x = old_width; x < width; x++) {
+                    cell *old_c = &cells_last_flush[y * width + x];
+                    old_c->text_len = 1;
+                    old_c->text[0] = '\x01';
+                }
+                if (width > old_width) {
+                    termpaintp_surface_damage(surface, y, old_width, width - 1);
+                }
+            }
+        } else {
+            surface->terminal->force_full_repaint = true;
+            termpaintp_surface_reset_damage(surface);
         }
     }
     return true;
@@ -752,129 +1383,243 @@ static void termpaintp_set_overflow_text(termpaint_surface *surface, cell *dst_c
     dst_cell->text_overflow = overflow_ptr;
 }
 
-static void termpaintp_surface_destroy(termpaint_surface *surface) {
-    free(surface->cells);
-    free(surface->cells_last_flush);
-    termpaintp_hash_destroy(&surface->overflow_text);
-
-    if (surface->patches) {
-        for (int i = 0; i < 255; ++i) {
-            free(surface->patches[i].setup);
-            free(surface->patches[i].cleanup);
+// Clears tracked damage that lies completely inside the given rectangle. Damage that overlaps the rectangle is trimmed
+// if it extends only on one side.
+static void termpaintp_tracked_damage_reset(termpaint_surface *surface, int x, int y, int width, int height) {
+    if (!surface->tracked_damage) {
+        return;
+    }
+    const int x_end = x + width - 1;
+    for (int y1 = y; y1 < y + height; y1++) {
+        termpaintp_row_damage *damage = &surface->tracked_damage[y1];
+        if (damage->x1 < damage->x0) {
+            continue;
+        }
+        if (x <= damage->x0 && damage->x1 <= x_end) {
+            damage->x0 = surface->width;
+            damage->x1 = -1;
+        } else if (x <= damage->x0 && damage->x0 <= x_end) {
+            damage->x0 = x_end + 1;
+        } else if (x <= damage->x1 && damage->x1 <= x_end) {
+            damage->x1 = x - 1;
         }
-        free(surface->patches);
-        surface->patches = nullptr;
     }
-    termpaintp_collapse(surface);
 }
 
-static uint8_t termpaintp_surface_ensure_patch_idx(termpaint_surface *surface, bool optimize, unsigned char *setup,
-                                                unsigned char *cleanup) {
-    if (!setup || !cleanup) {
-        return 0;
-    }
-
-    if (!surface->patches) {
-        surface->patches = calloc(255, sizeof(termpaintp_patch));
-        if (!surface->patches) {
-            if (!surface->terminal->glitch_on_oom) {
-                termpaintp_oom(surface->terminal);
-            } else {
-                termpaintp_oom_log_only(surface->terminal);
-                return 0;
-            }
-        }
+static void termpaintp_surface_unlink_view(termpaint_surface *surface) {
+    termpaint_surface **link = surface->cow_duplicate ? &surface->view_parent->first_cow_duplicate
+                                                      : &surface->view_parent->first_view;
+    while (*link != surface) {
+        link = &(*link)->next_view;
     }
+    *link = surface->next_view;
+    surface->next_view = nullptr;
+    surface->view_parent = nullptr;
+    surface->cow_duplicate = false;
+}
 
-    uint32_t setup_hash = termpaintp_hash_fnv1a(setup);
-    uint32_t cleanup_hash = termpaintp_hash_fnv1a(cleanup);
-
-    int free_slot = -1;
+// Gives a copy-on-write duplicate its own copy of the contents of its parent. The parent's tables are copied
+// directly, so this is much cheaper than copying cell by cell.
+static void termpaintp_surface_unshare(termpaint_surface *surface) {
+    const termpaint_surface *source = surface->view_parent;
+    termpaintp_surface_unlink_view(surface);
+    surface->width = 0;
+    surface->height = 0;
+    termpaint_surface_resize(surface, source->width, source->height);
+    // the visible contents do not change
+    termpaintp_tracked_damage_reset(surface, 0, 0, surface->width, surface->height);
 
-    for (int i = 0; i < 255; ++i) {
-        if (!surface->patches[i].setup) {
-            if (free_slot == -1) {
-                free_slot = i;
-            }
-            continue;
+    termpaintp_attr_table *table = &surface->attrs;
+    if (!source->attrs.entries) {
+        // source was collapsed before it ever had a valid size
+        return;
+    }
+    if (table->allocated < source->attrs.allocated) {
+        termpaintp_attr_entry *entries = realloc(table->entries,
+                                                 source->attrs.allocated * sizeof(termpaintp_attr_entry));
+        if (entries) {
+            table->entries = entries;
         }
-
-        if (surface->patches[i].setup_hash == setup_hash
-                && surface->patches[i].cleanup_hash == cleanup_hash
-                && ustrcmp(setup, surface->patches[i].setup) == 0
-                && ustrcmp(cleanup, surface->patches[i].cleanup) == 0) {
-            return i + 1;
+        uint32_t *buckets = realloc(table->buckets, source->attrs.allocated * sizeof(uint32_t));
+        if (buckets) {
+            table->buckets = buckets;
         }
-    }
-
-    if (free_slot == -1) {
-        // try to free unused entries
-        for (int i = 0; i < 255; ++i) {
-            surface->patches[i].unused = true;
+        if (!entries || !buckets) {
+            termpaintp_oom(surface->terminal);
         }
-
-        for (int y = 0; y < surface->height; y++) {
-            for (int x = 0; x < surface->width; x++) {
-                cell* c = termpaintp_getcell(surface, x, y);
-                if (c->attr_patch_idx) {
-                    surface->patches[c->attr_patch_idx - 1].unused = false;
-                }
-                if (surface->cells_last_flush) {
-                    cell* old_c = &surface->cells_last_flush[y*surface->width+x];
-                    if (old_c->attr_patch_idx) {
-                        surface->patches[old_c->attr_patch_idx - 1].unused = false;
-                    }
-                }
-            }
+        table->allocated = source->attrs.allocated;
+    }
+    memcpy(table->entries, source->attrs.entries, source->attrs.used * sizeof(termpaintp_attr_entry));
+    table->used = source->attrs.used;
+    termpaintp_attr_table_forget_quantized(table);
+    termpaintp_attr_table_rebuild(table);
+
+    if (source->patches.entries) {
+        termpaintp_patch_table *patches = &surface->patches;
+        patches->entries = malloc(source->patches.allocated * sizeof(termpaintp_patch));
+        patches->buckets = malloc(source->patches.allocated * sizeof(uint32_t));
+        if (!patches->entries || !patches->buckets) {
+            termpaintp_oom(surface->terminal);
         }
-
-        for (int i = 0; i < 255; ++i) {
-            if (surface->patches[i].unused) {
-                free(surface->patches[i].setup);
-                free(surface->patches[i].cleanup);
-                surface->patches[i].setup = nullptr;
-                surface->patches[i].cleanup = nullptr;
-
-                if (free_slot == -1) {
-                    free_slot = i;
-                }
+        memcpy(patches->entries, source->patches.entries, source->patches.used * sizeof(termpaintp_patch));
+        memcpy(patches->buckets, source->patches.buckets, source->patches.allocated * sizeof(uint32_t));
+        patches->allocated = source->patches.allocated;
+        patches->used = source->patches.used;
+        patches->free_list = source->patches.free_list;
+        for (unsigned i = 0; i < patches->used; ++i) {
+            termpaintp_patch *patch = &patches->entries[i];
+            if (!patch->setup) {
+                continue;
             }
-        }
-    }
-
-    if (free_slot != -1) {
-        unsigned char *setup_copy = ustrdup(setup);
-        unsigned char *cleanup_copy = ustrdup(cleanup);
-        if (!setup_copy || !cleanup_copy) {
-            if (!surface->terminal->glitch_on_oom) {
+            patch->setup = ustrdup(patch->setup);
+            patch->cleanup = ustrdup(patch->cleanup);
+            if (!patch->setup || !patch->cleanup) {
                 termpaintp_oom(surface->terminal);
-            } else {
-                free(setup_copy);
-                free(cleanup_copy);
-                termpaintp_oom_log_only(surface->terminal);
-                return 0;
             }
         }
-        surface->patches[free_slot].optimize = optimize;
-        surface->patches[free_slot].setup_hash = setup_hash;
-        surface->patches[free_slot].cleanup_hash = cleanup_hash;
-        surface->patches[free_slot].setup = setup_copy;
-        surface->patches[free_slot].cleanup = cleanup_copy;
-
-        return free_slot + 1;
     }
 
-    // can't fit anymore, just ignore it.
-    return 0;
+    const int count = surface->width * surface->height;
+    for (int i = 0; i < count; i++) {
+        const cell *src = &source->cells[i];
+        cell *dst = &surface->cells[i];
+        *dst = *src;
+        if (src->text_len == 0 && src->text_overflow != nullptr && src->text_overflow != WIDE_RIGHT_PADDING) {
+            // the overflow text belongs to the parent, this surface needs its own entry
+            dst->text_overflow = nullptr;
+            termpaintp_set_overflow_text(surface, dst, src->text_overflow->text);
+        }
+    }
 }
 
-void termpaint_surface_write_with_colors(termpaint_surface *surface, int x, int y, const char *string, int fg, int bg) {
-    termpaint_surface_write_with_colors_clipped(surface, x, y, string, fg, bg, 0, surface->width-1);
+// Must be called before any change to the contents of surface. If surface is a copy-on-write duplicate or has
+// copy-on-write duplicates, they stop sharing their contents. For views this applies to the parent.
+static inline void termpaintp_surface_prepare_write(const termpaint_surface *surface) {
+    if (surface->cow_duplicate) {
+        termpaintp_surface_unshare((termpaint_surface*)surface);
+    } else if (surface->view_parent) {
+        surface = surface->view_parent;
+    }
+    while (surface->first_cow_duplicate) {
+        termpaintp_surface_unshare(surface->first_cow_duplicate);
+    }
 }
 
-void termpaint_surface_write_with_len_colors(termpaint_surface *surface, int x, int y, const char *string, int len, int fg, int bg) {
-    termpaint_surface_write_with_len_colors_clipped(surface, x, y, string, len, fg, bg, 0, surface->width-1);
-}
+static void termpaintp_surface_destroy(termpaint_surface *surface) {
+    if (surface->view_parent) {
+        termpaintp_surface_unlink_view(surface);
+    }
+    while (surface->first_cow_duplicate) {
+        termpaintp_surface_unshare(surface->first_cow_duplicate);
+    }
+    // Views that outlive their parent are left without any cells.
+    while (surface->first_view) {
+        termpaint_surface *view = surface->first_view;
+        surface->first_view = view->next_view;
+        view->view_parent = nullptr;
+        view->next_view = nullptr;
+        view->width = 0;
+        view->height = 0;
+    }
+    free(surface->cells);
+    free(surface->cells_last_flush);
+    free(surface->row_damage);
+    free(surface->tracked_damage);
+    termpaintp_hash_destroy(&surface->overflow_text);
+    termpaintp_attr_table_destroy(&surface->attrs);
+    termpaintp_patch_table_destroy(&surface->patches);
+    memset(surface->patch_cache, 0, sizeof(surface->patch_cache));
+    termpaintp_collapse(surface);
+}
+
+static uint32_t termpaintp_surface_ensure_patch_idx(termpaint_surface *surface, bool optimize, unsigned char *setup,
+                                                    unsigned char *cleanup) {
+    if (!setup || !cleanup) {
+        return 0;
+    }
+
+    termpaintp_patch_table *table = &surface->patches;
+    const uint32_t setup_hash = termpaintp_hash_fnv1a(setup);
+    const uint32_t cleanup_hash = termpaintp_hash_fnv1a(cleanup);
+    const uint32_t hash = termpaintp_patch_hash(setup_hash, cleanup_hash);
+
+    if (table->allocated) {
+        for (uint32_t id = table->buckets[hash & (table->allocated - 1)]; id != PATCH_ID_NONE;
+             id = table->entries[id].next) {
+            const termpaintp_patch *patch = &table->entries[id];
+            if (patch->setup_hash == setup_hash
+                    && patch->cleanup_hash == cleanup_hash
+                    && ustrcmp(setup, patch->setup) == 0
+                    && ustrcmp(cleanup, patch->cleanup) == 0) {
+                return id + 1;
+            }
+        }
+    }
+
+    if (!table->entries || (table->free_list == PATCH_ID_NONE && table->used == table->allocated)) {
+        // Patches are freed together with the last attribute table entry using them. Small attribute tables are not
+        // collected when they are full, so collect them here before growing to free the patches of unused entries.
+        unsigned free_patches = 0;
+        if (table->entries) {
+            termpaintp_surface_attrs_gc(surface);
+            for (uint32_t id = table->free_list; id != PATCH_ID_NONE; id = table->entries[id].next) {
+                free_patches++;
+            }
+        }
+        if (!table->entries || free_patches < table->allocated / 4) {
+            if (!termpaintp_patch_table_grow(table) && free_patches == 0) {
+                if (!surface->terminal->glitch_on_oom) {
+                    termpaintp_oom(surface->terminal);
+                } else {
+                    termpaintp_oom_log_only(surface->terminal);
+                    return 0;
+                }
+            }
+        }
+    }
+
+    unsigned char *setup_copy = ustrdup(setup);
+    unsigned char *cleanup_copy = ustrdup(cleanup);
+    if (!setup_copy || !cleanup_copy) {
+        if (!surface->terminal->glitch_on_oom) {
+            termpaintp_oom(surface->terminal);
+        } else {
+            free(setup_copy);
+            free(cleanup_copy);
+            termpaintp_oom_log_only(surface->terminal);
+            return 0;
+        }
+    }
+
+    uint32_t id;
+    if (table->free_list != PATCH_ID_NONE) {
+        id = table->free_list;
+        table->free_list = table->entries[id].next;
+    } else {
+        id = table->used++;
+    }
+    termpaintp_patch *patch = &table->entries[id];
+    patch->optimize = optimize;
+    patch->setup_hash = setup_hash;
+    patch->cleanup_hash = cleanup_hash;
+    patch->setup = setup_copy;
+    patch->cleanup = cleanup_copy;
+    // references are only counted once the patch is used by an entry in the attribute table
+    patch->refcount = 0;
+    uint32_t *bucket = &table->buckets[hash & (table->allocated - 1)];
+    patch->next = *bucket;
+    *bucket = id;
+
+    return id + 1;
+}
+
+void termpaint_surface_write_with_colors(termpaint_surface *surface, int x, int y, const char *string, int fg, int bg) {
+    termpaint_surface_write_with_colors_clipped(surface, x, y, string, fg, bg, 0, surface->width-1);
+}
+
+void termpaint_surface_write_with_len_colors(termpaint_surface *surface, int x, int y, const char *string, int len, int fg, int bg) {
+    termpaint_surface_write_with_len_colors_clipped(surface, x, y, string, len, fg, bg, 0, surface->width-1);
+}
 
 void termpaint_surface_write_with_colors_clipped(termpaint_surface *surface, int x, int y, const char *string, int fg, int bg, int clip_x0, int clip_x1) {
     int len = strlen(string);
@@ -906,7 +1651,9 @@ static void termpaintp_surface_vanish_char(termpaint_surface *surface, int x, in
     // narrow contract, x + cluster_width <= width
     cell *cell = termpaintp_getcell(surface, x, y);
 
+    int leftmost_vanished = x;
     int rightmost_vanished = x;
+    int rightmost_touched = x + cluster_width - 1;
 
     if (cell->text_len == 0 && cell->text_overflow == WIDE_RIGHT_PADDING) {
         int i = x;
@@ -934,6 +1681,7 @@ static void termpaintp_surface_vanish_char(termpaint_surface *surface, int x, in
             --i;
         } while (cell->cluster_expansion == 0);
         cell->cluster_expansion = 0;
+        leftmost_vanished = i + 1;
     }
 
     for (int i = rightmost_vanished; i <= x + cluster_width - 1; i++) {
@@ -952,16 +1700,100 @@ static void termpaintp_surface_vanish_char(termpaint_surface *surface, int x, in
             cell = termpaintp_getcell(surface, i + j, y);
         }
         i += expansion;
+        if (i > rightmost_touched) {
+            rightmost_touched = i;
+        }
     }
+
+    termpaintp_surface_changed(surface, y, leftmost_vanished,
+                               rightmost_vanished > rightmost_touched ? rightmost_vanished : rightmost_touched);
 }
 
-static void termpaintp_surface_attr_apply(termpaint_surface *surface, cell *cell, termpaint_attr const *attr) {
-    cell->fg_color = attr->fg_color;
-    cell->bg_color = attr->bg_color;
-    cell->deco_color = attr->deco_color;
-    cell->flags = attr->flags;
-    cell->attr_patch_idx = termpaintp_surface_ensure_patch_idx(surface, attr->patch_optimize,
-                                                               attr->patch_setup, attr->patch_cleanup);
+static uint32_t termpaintp_surface_attr_patch_idx(termpaint_surface *surface, termpaint_attr const *attr) {
+    if (!attr->patch_setup) {
+        return 0;
+    }
+    termpaintp_patch_cache_entry *cached = &surface->patch_cache[attr->patch_serial % TERMPAINTP_PATCH_CACHE_SIZE];
+    if (cached->serial == attr->patch_serial && cached->generation == surface->attrs.generation) {
+        return cached->patch_idx;
+    }
+    const uint32_t patch_idx = termpaintp_surface_ensure_patch_idx(surface, attr->patch_optimize,
+                                                                  attr->patch_setup, attr->patch_cleanup);
+    if (patch_idx) {
+        cached->serial = attr->patch_serial;
+        cached->generation = surface->attrs.generation;
+        cached->patch_idx = patch_idx;
+    }
+    return patch_idx;
+}
+
+static uint32_t termpaintp_surface_intern_public_attr(termpaint_surface *surface, termpaint_attr const *attr) {
+    const uint32_t patch_idx = termpaintp_surface_attr_patch_idx(surface, attr);
+    const termpaintp_attr_entry entry = termpaintp_attr_make(attr->fg_color, attr->bg_color, attr->deco_color,
+                                                             attr->flags, patch_idx);
+    return termpaintp_surface_intern_attr(surface, &entry);
+}
+
+static inline void termpaintp_surface_attr_apply(termpaint_surface *surface, cell *cell, termpaint_attr const *attr,
+                                                 uint32_t *attr_id) {
+    if (*attr_id == ATTR_ID_NONE) {
+        // Interned on first use. Writing does not add attributes otherwise, so the id stays valid while writing.
+        *attr_id = termpaintp_surface_intern_public_attr(surface, attr);
+    }
+    cell->attr_id = *attr_id;
+    cell->flags = 0;
+}
+
+// Returns the length of the prefix of string that only contains printable ASCII (0x20 to 0x7e). Checks 16 or 8 bytes
+// at a time, only the block containing the end of the prefix is scanned bytewise.
+static int termpaintp_printable_ascii_prefix(const unsigned char *string, int len) {
+    int i = 0;
+#ifdef __SSE2__
+    // bytes >= 0x80 compare as negative
+    const __m128i below_space = _mm_set1_epi8(0x1f);
+    const __m128i del = _mm_set1_epi8(0x7f);
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(const void*)(string + i));
+        __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(v, below_space), _mm_cmplt_epi8(v, del));
+        if (_mm_movemask_epi8(printable) != 0xffff) {
+            break;
+        }
+    }
+#endif
+    const uint64_t ones = 0x0101010101010101ull;
+    const uint64_t high_bits = 0x8080808080808080ull;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t v;
+        memcpy(&v, string + i, 8);
+        const uint64_t below_space = (v - 0x20 * ones) & ~v;
+        const uint64_t del = v ^ (0x7f * ones);
+        const uint64_t is_del = (del - ones) & ~del;
+        if ((v | below_space | is_del) & high_bits) {
+            break;
+        }
+    }
+    while (i < len && string[i] >= 0x20 && string[i] < 0x7f) {
+        ++i;
+    }
+    return i;
+}
+
+// Stores a run of printable ASCII characters. Each of them is a cluster of width 1, so no decoding or width lookup is
+// needed.
+static void termpaintp_surface_write_ascii_run(termpaint_surface *surface, int x, int y,
+                                               const unsigned char *string, int run,
+                                               termpaint_attr const *attr, uint32_t *attr_id) {
+    // narrow contract, x + run <= width
+    termpaintp_surface_vanish_char(surface, x, y, 1);
+    termpaintp_surface_vanish_char(surface, x + run - 1, y, 1);
+    termpaintp_surface_changed(surface, y, x, x + run - 1);
+    cell *row = termpaintp_getcell(surface, x, y);
+    for (int i = 0; i < run; i++) {
+        termpaintp_surface_attr_apply(surface, &row[i], attr, attr_id);
+        row[i].cluster_expansion = 0;
+        row[i].text[0] = string[i];
+        row[i].text_len = 1;
+    }
 }
 
 void termpaint_surface_write_with_attr_clipped(termpaint_surface *surface, int x, int y, const char *string_s, termpaint_attr const *attr, int clip_x0, int clip_x1) {
@@ -969,9 +1801,11 @@ void termpaint_surface_write_with_attr_clipped(termpaint_surface *surface, int x
     termpaint_surface_write_with_len_attr_clipped(surface, x, y, string_s, len, attr, clip_x0, clip_x1);
 }
 
-void termpaint_surface_write_with_len_attr_clipped(termpaint_surface *surface, int x, int y, const char *string_s, int len, termpaint_attr const *attr, int clip_x0, int clip_x1) {
+// Writes to a surface that owns its cells. *attr_id is the interned id of attr or ATTR_ID_NONE if it is not yet known,
+// it is updated when attr is interned.
+static void termpaintp_surface_write(termpaint_surface *surface, int x, int y, const unsigned char *string, int len,
+                                     termpaint_attr const *attr, uint32_t *attr_id, int clip_x0, int clip_x1) {
     const termpaintp_width *char_width_table = surface->terminal->char_width_table;
-    const unsigned char *string = (const unsigned char *)string_s;
     if (y < 0) return;
     if (clip_x0 < 0) clip_x0 = 0;
     if (clip_x1 >= surface->width) {
@@ -982,6 +1816,24 @@ void termpaint_surface_write_with_len_attr_clipped(termpaint_surface *surface, i
             return;
         }
 
+        if (x >= clip_x0 && string[0] >= 0x20 && string[0] < 0x7f) {
+            int run = termpaintp_printable_ascii_prefix(string, len);
+            if (run < len) {
+                // the last character of the run starts a cluster that might continue with combining characters
+                --run;
+            }
+            if (run > clip_x1 - x + 1) {
+                run = clip_x1 - x + 1;
+            }
+            if (run > 0) {
+                termpaintp_surface_write_ascii_run(surface, x, y, string, run, attr, attr_id);
+                string += run;
+                len -= run;
+                x += run;
+                continue;
+            }
+        }
+
         unsigned char cluster_utf8[40];
         int cluster_width = 1;
         int input_bytes_used = 0;
@@ -1043,9 +1895,10 @@ void termpaint_surface_write_with_len_attr_clipped(termpaint_surface *surface, i
             cell *c = termpaintp_getcell(surface, x + 1, y);
 
             termpaintp_surface_vanish_char(surface, x + 1, y, cluster_width - 1);
+            termpaintp_surface_changed(surface, y, x + 1, x + 1);
 
             c->cluster_expansion = 0;
-            termpaintp_surface_attr_apply(surface, c, attr);
+            termpaintp_surface_attr_apply(surface, c, attr, attr_id);
 
             c->text[0] = ' ';
             c->text_len = 1;
@@ -1054,9 +1907,10 @@ void termpaint_surface_write_with_len_attr_clipped(termpaint_surface *surface, i
             cell *c = termpaintp_getcell(surface, x, y);
 
             termpaintp_surface_vanish_char(surface, x, y, cluster_width - 1);
+            termpaintp_surface_changed(surface, y, x, x);
 
             c->cluster_expansion = 0;
-            termpaintp_surface_attr_apply(surface, c, attr);
+            termpaintp_surface_attr_apply(surface, c, attr, attr_id);
 
             c->text[0] = ' ';
             c->text_len = 1;
@@ -1064,8 +1918,9 @@ void termpaint_surface_write_with_len_attr_clipped(termpaint_surface *surface, i
             cell *c = termpaintp_getcell(surface, x, y);
 
             termpaintp_surface_vanish_char(surface, x, y, cluster_width);
+            termpaintp_surface_changed(surface, y, x, x + cluster_width - 1);
 
-            termpaintp_surface_attr_apply(surface, c, attr);
+            termpaintp_surface_attr_apply(surface, c, attr, attr_id);
 
             c->cluster_expansion = cluster_width - 1;
             if (output_bytes_used <= 8) {
@@ -1082,7 +1937,7 @@ void termpaint_surface_write_with_len_attr_clipped(termpaint_surface *surface, i
             }
             for (int i = 1; i < cluster_width; i++) {
                 cell *c = termpaintp_getcell(surface, x + i, y);
-                termpaintp_surface_attr_apply(surface, c, attr);
+                termpaintp_surface_attr_apply(surface, c, attr, attr_id);
                 c->cluster_expansion = 0;
                 c->text_len = 0;
                 c->text_overflow = WIDE_RIGHT_PADDING;
@@ -1095,6 +1950,90 @@ void termpaint_surface_write_with_len_attr_clipped(termpaint_surface *surface, i
     }
 }
 
+void termpaint_surface_write_with_len_attr_clipped(termpaint_surface *surface, int x, int y, const char *string_s, int len, termpaint_attr const *attr, int clip_x0, int clip_x1) {
+    termpaintp_surface_prepare_write(surface);
+    if (surface->view_parent) {
+        if (y < 0 || y >= surface->height) return;
+        if (clip_x0 < 0) clip_x0 = 0;
+        if (clip_x1 >= surface->width) clip_x1 = surface->width - 1;
+        if (x > clip_x1) return;
+        termpaint_surface_write_with_len_attr_clipped(surface->view_parent, x + surface->view_x, y + surface->view_y,
+                                                      string_s, len, attr,
+                                                      clip_x0 + surface->view_x, clip_x1 + surface->view_x);
+        return;
+    }
+    uint32_t attr_id = ATTR_ID_NONE;
+    termpaintp_surface_write(surface, x, y, (const unsigned char *)string_s, len, attr, &attr_id, clip_x0, clip_x1);
+}
+
+typedef struct termpaintp_span_order_ {
+    int y;
+    int index;
+} termpaintp_span_order;
+
+static int termpaintp_span_order_compare(const void *a, const void *b) {
+    const termpaintp_span_order *order_a = a;
+    const termpaintp_span_order *order_b = b;
+    if (order_a->y != order_b->y) {
+        return order_a->y < order_b->y ? -1 : 1;
+    }
+    return order_a->index < order_b->index ? -1 : order_a->index > order_b->index;
+}
+
+void termpaint_surface_write_spans(termpaint_surface *surface, const termpaint_write_span *spans, int count) {
+    termpaintp_surface_prepare_write(surface);
+    termpaint_surface *target = surface->view_parent ? surface->view_parent : surface;
+    const int offset_x = surface->view_parent ? surface->view_x : 0;
+    const int offset_y = surface->view_parent ? surface->view_y : 0;
+
+    // Spans only change cells in their row, so sorting them by row (keeping the order within a row) does not change
+    // the result but keeps writes to the cell array local.
+    termpaintp_span_order *order = nullptr;
+    for (int i = 1; i < count; i++) {
+        if (spans[i].y < spans[i - 1].y) {
+            order = malloc(count * sizeof(termpaintp_span_order));
+            break;
+        }
+    }
+    if (order) {
+        for (int i = 0; i < count; i++) {
+            order[i].y = spans[i].y;
+            order[i].index = i;
+        }
+        qsort(order, count, sizeof(termpaintp_span_order), termpaintp_span_order_compare);
+    }
+
+    // Ids of recently used attributes. Ids are only reused after garbage collection, so the cache is dropped when the
+    // generation of the attribute table changes.
+    struct {
+        const termpaint_attr *attr;
+        uint32_t attr_id;
+    } cache[16];
+    memset(cache, 0, sizeof(cache));
+    unsigned cache_generation = target->attrs.generation;
+
+    for (int i = 0; i < count; i++) {
+        const termpaint_write_span *span = &spans[order ? order[i].index : i];
+        if (span->y < 0 || span->y >= surface->height) {
+            continue;
+        }
+        const unsigned slot = ((uintptr_t)span->attr >> 4) % 16;
+        uint32_t attr_id = cache[slot].attr == span->attr ? cache[slot].attr_id : ATTR_ID_NONE;
+        const int len = span->len < 0 ? (int)strlen(span->text) : span->len;
+        termpaintp_surface_write(target, span->x + offset_x, span->y + offset_y, (const unsigned char *)span->text,
+                                 len, span->attr, &attr_id, offset_x, offset_x + surface->width - 1);
+        if (cache_generation != target->attrs.generation) {
+            cache_generation = target->attrs.generation;
+            memset(cache, 0, sizeof(cache));
+        }
+        if (attr_id != ATTR_ID_NONE) {
+            cache[slot].attr = span->attr;
+            cache[slot].attr_id = attr_id;
+        }
+    }
+    free(order);
+}
+
 void termpaint_surface_clear_with_attr(termpaint_surface *surface, const termpaint_attr *attr) {
     termpaint_surface_clear_rect_with_attr(surface, 0, 0, surface->width, surface->height, attr);
 }
@@ -1114,6 +2053,7 @@ void termpaint_surface_clear_with_char(termpaint_surface *surface, int fg, int b
 static void termpaintp_surface_clear_rect_with_attr_and_string(termpaint_surface *surface, int x, int y,
                                                                int width, int height, const termpaint_attr *attr,
                                                                const unsigned char* str, unsigned len) {
+    termpaintp_surface_prepare_write(surface);
     if (x < 0) {
         width += x;
         x = 0;
@@ -1127,9 +2067,18 @@ static void termpaintp_surface_clear_rect_with_attr_and_string(termpaint_surface
     if (y >= surface->height) return;
     if (x+width > surface->width) width = surface->width - x;
     if (y+height > surface->height) height = surface->height - y;
+    if (surface->view_parent) {
+        termpaintp_surface_clear_rect_with_attr_and_string(surface->view_parent, x + surface->view_x,
+                                                           y + surface->view_y, width, height, attr, str, len);
+        return;
+    }
+    const termpaintp_attr_entry entry = termpaintp_attr_make(attr->fg_color, attr->bg_color, TERMPAINT_DEFAULT_COLOR,
+                                                             attr->flags, 0);
+    const uint32_t attr_id = termpaintp_surface_intern_attr(surface, &entry);
     for (int y1 = y; y1 < y + height; y1++) {
         termpaintp_surface_vanish_char(surface, x, y1, 1);
         termpaintp_surface_vanish_char(surface, x + width - 1, y1, 1);
+        termpaintp_surface_changed(surface, y1, x, x + width - 1);
         for (int x1 = x; x1 < x + width; x1++) {
             cell* c = termpaintp_getcell(surface, x1, y1);
             c->cluster_expansion = 0;
@@ -1140,11 +2089,8 @@ static void termpaintp_surface_clear_rect_with_attr_and_string(termpaint_surface
                 c->text_len = 0;
                 c->text_overflow = nullptr;
             }
-            c->bg_color = attr->bg_color;
-            c->fg_color = attr->fg_color;
-            c->deco_color = TERMPAINT_DEFAULT_COLOR;
-            c->flags = attr->flags;
-            c->attr_patch_idx = 0;
+            c->attr_id = attr_id;
+            c->flags = 0;
         }
     }
 }
@@ -1196,7 +2142,24 @@ void termpaint_surface_clear_rect_with_char(termpaint_surface *surface, int x, i
     }
 }
 
+enum termpaintp_color_slot { COLOR_SLOT_FG, COLOR_SLOT_BG, COLOR_SLOT_DECO };
+
+static void termpaintp_surface_cell_set_color(termpaint_surface *surface, cell *c, enum termpaintp_color_slot slot,
+                                              uint32_t color) {
+    termpaintp_attr_entry entry = *termpaintp_cell_attr(surface, c);
+    if (slot == COLOR_SLOT_FG) {
+        entry.fg_color = color;
+    } else if (slot == COLOR_SLOT_BG) {
+        entry.bg_color = color;
+    } else {
+        entry.deco_color = color;
+    }
+    c->attr_id = termpaintp_surface_intern_attr(surface, &entry);
+}
+
 void termpaint_surface_set_fg_color(const termpaint_surface *surface, int x, int y, unsigned fg) {
+    termpaintp_surface_prepare_write(surface);
+    if (!termpaintp_view_translate(&surface, &x, &y)) return;
     if (x < 0) return;
     if (y < 0) return;
     if (x >= surface->width) return;
@@ -1209,14 +2172,17 @@ void termpaint_surface_set_fg_color(const termpaint_surface *surface, int x, int
         return;
     }
 
-    c->fg_color = fg;
+    termpaintp_surface_changed((termpaint_surface*)surface, y, x, x + c->cluster_expansion);
+    termpaintp_surface_cell_set_color((termpaint_surface*)surface, c, COLOR_SLOT_FG, fg);
     for (int i = 0; i < c->cluster_expansion; i++) {
         cell* exp_cell = termpaintp_getcell(surface, x + 1 + i, y);
-        exp_cell->fg_color = fg;
+        termpaintp_surface_cell_set_color((termpaint_surface*)surface, exp_cell, COLOR_SLOT_FG, fg);
     }
 }
 
 void termpaint_surface_set_bg_color(const termpaint_surface *surface, int x, int y, unsigned bg) {
+    termpaintp_surface_prepare_write(surface);
+    if (!termpaintp_view_translate(&surface, &x, &y)) return;
     if (x < 0) return;
     if (y < 0) return;
     if (x >= surface->width) return;
@@ -1229,14 +2195,17 @@ void termpaint_surface_set_bg_color(const termpaint_surface *surface, int x, int
         return;
     }
 
-    c->bg_color = bg;
+    termpaintp_surface_changed((termpaint_surface*)surface, y, x, x + c->cluster_expansion);
+    termpaintp_surface_cell_set_color((termpaint_surface*)surface, c, COLOR_SLOT_BG, bg);
     for (int i = 0; i < c->cluster_expansion; i++) {
         cell* exp_cell = termpaintp_getcell(surface, x + 1 + i, y);
-        exp_cell->bg_color = bg;
+        termpaintp_surface_cell_set_color((termpaint_surface*)surface, exp_cell, COLOR_SLOT_BG, bg);
     }
 }
 
 void termpaint_surface_set_deco_color(const termpaint_surface *surface, int x, int y, unsigned deco_color) {
+    termpaintp_surface_prepare_write(surface);
+    if (!termpaintp_view_translate(&surface, &x, &y)) return;
     if (x < 0) return;
     if (y < 0) return;
     if (x >= surface->width) return;
@@ -1249,18 +2218,24 @@ void termpaint_surface_set_deco_color(const termpaint_surface *surface, int x, i
         return;
     }
 
-    c->deco_color = deco_color;
+    termpaintp_surface_changed((termpaint_surface*)surface, y, x, x + c->cluster_expansion);
+    termpaintp_surface_cell_set_color((termpaint_surface*)surface, c, COLOR_SLOT_DECO, deco_color);
     for (int i = 0; i < c->cluster_expansion; i++) {
         cell* exp_cell = termpaintp_getcell(surface, x + 1 + i, y);
-        exp_cell->deco_color = deco_color;
+        termpaintp_surface_cell_set_color((termpaint_surface*)surface, exp_cell, COLOR_SLOT_DECO, deco_color);
     }
 }
 
 void termpaint_surface_set_softwrap_marker(termpaint_surface *surface, int x, int y, bool state) {
+    termpaintp_surface_prepare_write(surface);
     if (x < 0) return;
     if (y < 0) return;
     if (x >= surface->width) return;
     if (y >= surface->height) return;
+    if (surface->view_parent) {
+        termpaint_surface_set_softwrap_marker(surface->view_parent, x + surface->view_x, y + surface->view_y, state);
+        return;
+    }
     cell* c = termpaintp_getcell(surface, x, y);
 
     if (c->text_len == 0 && c->text_overflow == WIDE_RIGHT_PADDING) {
@@ -1268,6 +2243,7 @@ void termpaint_surface_set_softwrap_marker(termpaint_surface *surface, int x, in
         return;
     }
 
+    termpaintp_surface_changed(surface, y, x, x);
     if (state) {
         c->flags |= CELL_SOFTWRAP_MARKER;
     } else {
@@ -1276,9 +2252,15 @@ void termpaint_surface_set_softwrap_marker(termpaint_surface *surface, int x, in
 }
 
 bool termpaint_surface_resize_mustcheck(termpaint_surface *surface, int width, int height) {
-    if (width < 0 || height < 0) {
+    termpaintp_surface_prepare_write(surface);
+    if (surface->view_parent) {
+        surface->view_width = width < 0 ? 0 : width;
+        surface->view_height = height < 0 ? 0 : height;
+        termpaintp_view_clip(surface);
+    } else if (width < 0 || height < 0) {
         free(surface->cells);
         free(surface->cells_last_flush);
+        free(surface->row_damage);
         termpaintp_collapse(surface);
     } else {
         if (!termpaintp_resize_mustcheck(surface, width, height)) {
@@ -1302,22 +2284,22 @@ int termpaint_surface_height(const termpaint_surface *surface) {
     return surface->height;
 }
 
+static void termpaintp_cells_mark_used_overflow(termpaint_surface *surface, cell *cells) {
+    const int count = surface->width * surface->height;
+    for (int i = 0; i < count; i++) {
+        cell* c = &cells[i];
+        if (c->text_len == 0 && c->text_overflow != nullptr && c->text_overflow != WIDE_RIGHT_PADDING) {
+            c->text_overflow->unused = false;
+        }
+    }
+}
+
 static void termpaintp_surface_gc_mark_cb(termpaint_hash *hash) {
     termpaint_surface *surface = container_of(hash, termpaint_surface, overflow_text);
 
-    for (int y = 0; y < surface->height; y++) {
-        for (int x = 0; x < surface->width; x++) {
-            cell* c = termpaintp_getcell(surface, x, y);
-            if (c->text_len == 0 && c->text_overflow != nullptr && c->text_overflow != WIDE_RIGHT_PADDING) {
-                c->text_overflow->unused = false;
-            }
-            if (surface->cells_last_flush) {
-                cell* old_c = &surface->cells_last_flush[y*surface->width+x];
-                if (old_c->text_len == 0 && old_c->text_overflow != nullptr && c->text_overflow != WIDE_RIGHT_PADDING) {
-                    old_c->text_overflow->unused = false;
-                }
-            }
-        }
+    termpaintp_cells_mark_used_overflow(surface, surface->cells);
+    if (surface->cells_last_flush) {
+        termpaintp_cells_mark_used_overflow(surface, surface->cells_last_flush);
     }
 }
 
@@ -1357,6 +2339,52 @@ termpaint_surface *termpaint_surface_new_surface_or_nullptr(termpaint_surface *s
     return termpaint_terminal_new_surface_or_nullptr(surface->terminal, width, height);
 }
 
+termpaint_surface *termpaint_surface_new_view_or_nullptr(termpaint_surface *surface, int x, int y, int width, int height) {
+    termpaint_surface *ret = calloc(1, sizeof(termpaint_surface));
+    if (!ret) {
+        return nullptr;
+    }
+    termpaintp_surface_init(ret, surface->terminal);
+    if (surface->cow_duplicate) {
+        termpaintp_surface_unshare(surface);
+    }
+    // Views of views are attached directly to the surface owning the cells.
+    if (x < 0) {
+        width += x;
+        x = 0;
+    }
+    if (y < 0) {
+        height += y;
+        y = 0;
+    }
+    if (x > surface->width) x = surface->width;
+    if (y > surface->height) y = surface->height;
+    if (width > surface->width - x) width = surface->width - x;
+    if (height > surface->height - y) height = surface->height - y;
+    if (surface->view_parent) {
+        x += surface->view_x;
+        y += surface->view_y;
+        surface = surface->view_parent;
+    }
+    ret->view_parent = surface;
+    ret->view_x = x;
+    ret->view_y = y;
+    ret->view_width = width < 0 ? 0 : width;
+    ret->view_height = height < 0 ? 0 : height;
+    ret->next_view = surface->first_view;
+    surface->first_view = ret;
+    termpaintp_view_clip(ret);
+    return ret;
+}
+
+termpaint_surface *termpaint_surface_new_view(termpaint_surface *surface, int x, int y, int width, int height) {
+    termpaint_surface *ret = termpaint_surface_new_view_or_nullptr(surface, x, y, width, height);
+    if (!ret) {
+        termpaintp_oom(surface->terminal);
+    }
+    return ret;
+}
+
 void termpaint_surface_free(termpaint_surface *surface) {
     if (!surface) {
         return;
@@ -1373,29 +2401,48 @@ void termpaint_surface_free(termpaint_surface *surface) {
 
 static void termpaintp_copy_colors_and_attibutes(termpaint_surface *src_surface, cell *src_cell,
                                                  termpaint_surface *dst_surface, cell *dst_cell) {
-    dst_cell->fg_color = src_cell->fg_color;
-    dst_cell->bg_color = src_cell->bg_color;
-    dst_cell->deco_color = src_cell->deco_color;
+    termpaintp_attr_entry entry = *termpaintp_cell_attr(src_surface, src_cell);
+    if (entry.patch_idx) {
+        termpaintp_patch* patch = &src_surface->patches.entries[entry.patch_idx - 1];
+        entry.patch_idx = termpaintp_surface_ensure_patch_idx(dst_surface,
+                                                              patch->optimize,
+                                                              patch->setup,
+                                                              patch->cleanup);
+    }
+    dst_cell->attr_id = termpaintp_surface_intern_attr(dst_surface, &entry);
     dst_cell->flags = src_cell->flags;
-    if (src_cell->attr_patch_idx) {
-        termpaintp_patch* patch = &src_surface->patches[src_cell->attr_patch_idx - 1];
-        dst_cell->attr_patch_idx = termpaintp_surface_ensure_patch_idx(dst_surface,
-                                                                       patch->optimize,
-                                                                       patch->setup,
-                                                                       patch->cleanup);
-    }
 }
 
 void termpaint_surface_tint(termpaint_surface *surface,
                             void (*recolor)(void *user_data, unsigned *fg, unsigned *bg, unsigned *deco),
                             void *user_data) {
-    for (int y = 0; y < surface->height; y++) {
-        for (int x = 0; x < surface->width; x++) {
+    termpaintp_surface_prepare_write(surface);
+    int x0 = 0;
+    int y0 = 0;
+    const int width = surface->width;
+    const int height = surface->height;
+    if (surface->view_parent) {
+        x0 = surface->view_x;
+        y0 = surface->view_y;
+        surface = surface->view_parent;
+    }
+    for (int y = y0; y < y0 + height; y++) {
+        int x = x0;
+        // a cluster that starts left of a view is recolored as a whole
+        while (x > 0) {
+            cell *cell = termpaintp_getcell(surface, x, y);
+            if (cell->text_len != 0 || cell->text_overflow != WIDE_RIGHT_PADDING) {
+                break;
+            }
+            --x;
+        }
+        const int row_start = x;
+        for (; x < x0 + width; x++) {
             cell *cell = termpaintp_getcell(surface, x, y);
             // Don't give out pointers to internal cell structure contents.
-            unsigned fg = cell->fg_color;
-            unsigned bg = cell->bg_color;
-            unsigned deco = cell->deco_color;
+            unsigned fg = termpaintp_cell_attr(surface, cell)->fg_color;
+            unsigned bg = termpaintp_cell_attr(surface, cell)->bg_color;
+            unsigned deco = termpaintp_cell_attr(surface, cell)->deco_color;
 
             recolor(user_data, &fg, &bg, &deco);
 
@@ -1404,12 +2451,15 @@ void termpaint_surface_tint(termpaint_surface *surface,
             // update cluster at once, different colors in one cluster are not allowed
             for (int i = 0; i <= expansion; i++) {
                 cell = termpaintp_getcell(surface, x + i, y);
-                cell->fg_color = fg;
-                cell->bg_color = bg;
-                cell->deco_color = deco;
+                termpaintp_attr_entry entry = *termpaintp_cell_attr(surface, cell);
+                entry.fg_color = fg;
+                entry.bg_color = bg;
+                entry.deco_color = deco;
+                cell->attr_id = termpaintp_surface_intern_attr(surface, &entry);
             }
             x += expansion;
         }
+        termpaintp_surface_changed(surface, y, row_start, x - 1);
     }
 }
 
@@ -1419,6 +2469,7 @@ static void termpaintp_surface_copy_rect_same_surface(termpaint_surface *src_sur
 
 void termpaint_surface_copy_rect(termpaint_surface *src_surface, int x, int y, int width, int height,
                                  termpaint_surface *dst_surface, int dst_x, int dst_y, int tile_left, int tile_right) {
+    termpaintp_surface_prepare_write(dst_surface);
     if (x < 0) {
         width += x;
         dst_x -= x;
@@ -1475,6 +2526,29 @@ void termpaint_surface_copy_rect(termpaint_surface *src_surface, int x, int y, i
         return;
     }
 
+    if (src_surface->view_parent || dst_surface->view_parent) {
+        // Edges of views are treated like the edges of surfaces, tiling must not reach across them.
+        if (tile_left >= TERMPAINT_COPY_TILE_PUT && (x == 0 || dst_x == 0)) {
+            tile_left = TERMPAINT_COPY_NO_TILE;
+        }
+        if (tile_right >= TERMPAINT_COPY_TILE_PUT && x + width >= src_surface->width) {
+            tile_right = TERMPAINT_COPY_NO_TILE;
+        }
+        if (src_surface->view_parent) {
+            x += src_surface->view_x;
+            y += src_surface->view_y;
+            src_surface = src_surface->view_parent;
+        }
+        if (dst_surface->view_parent) {
+            dst_x += dst_surface->view_x;
+            dst_y += dst_surface->view_y;
+            dst_surface = dst_surface->view_parent;
+        }
+        termpaint_surface_copy_rect(src_surface, x, y, width, height, dst_surface, dst_x, dst_y,
+                                    tile_left, tile_right);
+        return;
+    }
+
     if (src_surface == dst_surface) {
         termpaintp_surface_copy_rect_same_surface(src_surface, x, y, width, height, dst_x, dst_y, tile_left, tile_right);
         return;
@@ -1484,6 +2558,9 @@ void termpaint_surface_copy_rect(termpaint_surface *src_surface, int x, int y, i
         bool in_complete_cluster = false;
         int xOffset = 0;
 
+        // tiling can touch one cell on each side
+        termpaintp_surface_changed(dst_surface, dst_y + yOffset, dst_x - 1, dst_x + width);
+
         {
             cell *src_cell = termpaintp_getcell(src_surface, x, y + yOffset);
             if (src_cell->text_len == 0 && src_cell->text_overflow == WIDE_RIGHT_PADDING) {
@@ -1627,6 +2704,22 @@ static void termpaintp_surface_copy_rect_same_surface(termpaint_surface *dst_sur
 }
 
 termpaint_surface *termpaint_surface_duplicate(termpaint_surface *surface) {
+    if (!surface->view_parent || surface->cow_duplicate) {
+        termpaint_surface *source = surface->cow_duplicate ? surface->view_parent : surface;
+        termpaint_surface *ret = calloc(1, sizeof(termpaint_surface));
+        if (!ret) {
+            termpaintp_oom(surface->terminal);
+        }
+        termpaintp_surface_init(ret, surface->terminal);
+        ret->view_parent = source;
+        ret->cow_duplicate = true;
+        ret->width = ret->view_width = source->width;
+        ret->height = ret->view_height = source->height;
+        ret->next_view = source->first_cow_duplicate;
+        source->first_cow_duplicate = ret;
+        return ret;
+    }
+
     termpaint_surface *ret = termpaint_surface_new_surface(surface, surface->width, surface->height);
 
     termpaint_surface_copy_rect(surface, 0, 0, surface->width, surface->height,
@@ -1636,35 +2729,47 @@ termpaint_surface *termpaint_surface_duplicate(termpaint_surface *surface) {
 }
 
 unsigned termpaint_surface_peek_fg_color(const termpaint_surface *surface, int x, int y) {
+    if (!termpaintp_view_translate(&surface, &x, &y)) {
+        return 0;
+    }
     cell *cell = termpaintp_getcell_or_null(surface, x, y);
     if (!cell) {
         return 0;
     }
-    return cell->fg_color;
+    return termpaintp_cell_attr(surface, cell)->fg_color;
 }
 
 unsigned termpaint_surface_peek_bg_color(const termpaint_surface *surface, int x, int y) {
+    if (!termpaintp_view_translate(&surface, &x, &y)) {
+        return 0;
+    }
     cell *cell = termpaintp_getcell_or_null(surface, x, y);
     if (!cell) {
         return 0;
     }
-    return cell->bg_color;
+    return termpaintp_cell_attr(surface, cell)->bg_color;
 }
 
 unsigned termpaint_surface_peek_deco_color(const termpaint_surface *surface, int x, int y) {
+    if (!termpaintp_view_translate(&surface, &x, &y)) {
+        return 0;
+    }
     cell *cell = termpaintp_getcell_or_null(surface, x, y);
     if (!cell) {
         return 0;
     }
-    return cell->deco_color;
+    return termpaintp_cell_attr(surface, cell)->deco_color;
 }
 
 int termpaint_surface_peek_style(const termpaint_surface *surface, int x, int y) {
+    if (!termpaintp_view_translate(&surface, &x, &y)) {
+        return 0;
+    }
     cell *cell = termpaintp_getcell_or_null(surface, x, y);
     if (!cell) {
         return 0;
     }
-    unsigned flags = cell->flags;
+    unsigned flags = termpaintp_cell_attr(surface, cell)->flags;
     int style = flags & TERMPAINT_STYLE_PASSTHROUGH;
     if ((flags & CELL_ATTR_UNDERLINE_MASK) == CELL_ATTR_UNDERLINE_SINGLE) {
         style |= TERMPAINT_STYLE_UNDERLINE;
@@ -1677,27 +2782,31 @@ int termpaint_surface_peek_style(const termpaint_surface *surface, int x, int y)
 }
 
 void termpaint_surface_peek_patch(const termpaint_surface *surface, int x, int y, const char **setup, const char **cleanup, bool *optimize) {
-    cell *cell = termpaintp_getcell_or_null(surface, x, y);
-    if (!cell || !cell->attr_patch_idx) {
+    cell *cell = termpaintp_view_translate(&surface, &x, &y) ? termpaintp_getcell_or_null(surface, x, y) : nullptr;
+    const uint32_t patch_idx = cell ? termpaintp_cell_attr(surface, cell)->patch_idx : 0;
+    if (!patch_idx) {
         *setup = nullptr;
         *cleanup = nullptr;
         *optimize = true;
         return;
     }
-    termpaintp_patch* patch = &surface->patches[cell->attr_patch_idx - 1];
+    termpaintp_patch* patch = &surface->patches.entries[patch_idx - 1];
     *setup = (const char *)patch->setup;
     *cleanup = (const char *)patch->cleanup;
     *optimize = patch->optimize;
 }
 
 const char *termpaint_surface_peek_text(const termpaint_surface *surface, int x, int y, int *len, int *left, int *right) {
-    cell *cell = termpaintp_getcell_or_null(surface, x, y);
+    // left and right are reported in the coordinates of the view, a cluster can extend beyond a view's edges
+    const int view_x = x;
+    cell *cell = termpaintp_view_translate(&surface, &x, &y) ? termpaintp_getcell_or_null(surface, x, y) : nullptr;
+    const int offset_x = x - view_x;
     if (!cell) {
         if (left) {
-            *left = x;
+            *left = view_x;
         }
         if (right) {
-            *right = x;
+            *right = view_x;
         }
         *len = 1;
         return TERMPAINT_ERASED;
@@ -1711,7 +2820,7 @@ const char *termpaint_surface_peek_text(const termpaint_surface *surface, int x,
     }
 
     if (left) {
-        *left = x;
+        *left = x - offset_x;
     }
 
     const char *text;
@@ -1727,12 +2836,15 @@ const char *termpaint_surface_peek_text(const termpaint_surface *surface, int x,
     }
 
     if (right) {
-        *right = x + cell->cluster_expansion;
+        *right = x - offset_x + cell->cluster_expansion;
     }
     return text;
 }
 
 bool termpaint_surface_peek_softwrap_marker(const termpaint_surface *surface, int x, int y) {
+    if (!termpaintp_view_translate(&surface, &x, &y)) {
+        return false;
+    }
     cell *cell = termpaintp_getcell_or_null(surface, x, y);
     if (!cell) {
         return false;
@@ -1740,90 +2852,304 @@ bool termpaint_surface_peek_softwrap_marker(const termpaint_surface *surface, in
     return !!(cell->flags & CELL_SOFTWRAP_MARKER);
 }
 
-bool termpaint_surface_same_contents(const termpaint_surface *surface1, const termpaint_surface *surface2) {
-    if (surface1 == surface2) {
+// Compares one cell using the public peek functions. This handles all cases, including clusters that start outside
+// of a view.
+static bool termpaintp_surface_same_cell_peek(const termpaint_surface *surface1, const termpaint_surface *surface2,
+                                              int x, int y) {
+    if (termpaint_surface_peek_fg_color(surface1, x, y)
+            != termpaint_surface_peek_fg_color(surface2, x, y)) {
+        return false;
+    }
+    if (termpaint_surface_peek_bg_color(surface1, x, y)
+            != termpaint_surface_peek_bg_color(surface2, x, y)) {
+        return false;
+    }
+    if (termpaint_surface_peek_deco_color(surface1, x, y)
+            != termpaint_surface_peek_deco_color(surface2, x, y)) {
+        return false;
+    }
+    if (termpaint_surface_peek_style(surface1, x, y)
+            != termpaint_surface_peek_style(surface2, x, y)) {
+        return false;
+    }
+    if (termpaint_surface_peek_softwrap_marker(surface1, x, y)
+            != termpaint_surface_peek_softwrap_marker(surface2, x, y)) {
+        return false;
+    }
+    {
+        const char *setup1, *setup2;
+        const char *cleanup1, *cleanup2;
+        bool optimize1, optimize2;
+        termpaint_surface_peek_patch(surface1, x, y, &setup1, &cleanup1, &optimize1);
+        termpaint_surface_peek_patch(surface2, x, y, &setup2, &cleanup2, &optimize2);
+
+        if ((setup1 == nullptr || setup2 == nullptr || strcmp(setup1, setup2) != 0) && !(setup1 == nullptr && setup2 == nullptr)) {
+            return false;
+        }
+        if ((cleanup1 == nullptr || cleanup2 == nullptr || strcmp(cleanup1, cleanup2) != 0) && !(setup1 == nullptr && setup2 == nullptr)) {
+            return false;
+        }
+        if (optimize1 != optimize2) {
+            return false;
+        }
+    }
+    {
+        int left1, right1, len1;
+        int left2, right2, len2;
+        const char *text1 = termpaint_surface_peek_text(surface1, x, y, &len1, &left1, &right1);
+        const char *text2 = termpaint_surface_peek_text(surface2, x, y, &len2, &left2, &right2);
+
+        if (left1 != left2 || right1 != right2 || len1 != len2) {
+            return false;
+        }
+        if (memcmp(text1, text2, len1) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline const unsigned char *termpaintp_cell_text(const cell *c, int *len) {
+    if (c->text_len > 0) {
+        *len = c->text_len;
+        return c->text;
+    } else if (c->text_overflow == nullptr) {
+        *len = 1;
+        return (const unsigned char*)TERMPAINT_ERASED;
+    } else {
+        *len = ustrlen(c->text_overflow->text);
+        return c->text_overflow->text;
+    }
+}
+
+static bool termpaintp_same_attr(const termpaint_surface *surface1, uint32_t attr_id1,
+                                 const termpaint_surface *surface2, uint32_t attr_id2) {
+    if (surface1 == surface2 && attr_id1 == attr_id2) {
+        return true;
+    }
+    const termpaintp_attr_entry *attr1 = &surface1->attrs.entries[attr_id1];
+    const termpaintp_attr_entry *attr2 = &surface2->attrs.entries[attr_id2];
+    if (attr1->fg_color != attr2->fg_color || attr1->bg_color != attr2->bg_color
+            || attr1->deco_color != attr2->deco_color || attr1->flags != attr2->flags) {
+        return false;
+    }
+    if (!attr1->patch_idx || !attr2->patch_idx) {
+        return attr1->patch_idx == attr2->patch_idx;
+    }
+    if (surface1 == surface2 && attr1->patch_idx == attr2->patch_idx) {
         return true;
     }
+    const termpaintp_patch *patch1 = &surface1->patches.entries[attr1->patch_idx - 1];
+    const termpaintp_patch *patch2 = &surface2->patches.entries[attr2->patch_idx - 1];
+    return patch1->optimize == patch2->optimize
+            && ustrcmp(patch1->setup, patch2->setup) == 0
+            && ustrcmp(patch1->cleanup, patch2->cleanup) == 0;
+}
 
+bool termpaint_surface_find_difference(const termpaint_surface *surface1, const termpaint_surface *surface2,
+                                       int *x_out, int *y_out) {
     if (surface1->width != surface2->width
       || surface1->height != surface2->height) {
+        if (x_out) {
+            *x_out = -1;
+        }
+        if (y_out) {
+            *y_out = -1;
+        }
+        return true;
+    }
+
+    // Compare the cells in the surfaces owning them, views and copy-on-write duplicates only add an offset.
+    const termpaint_surface *storage1 = surface1->view_parent ? surface1->view_parent : surface1;
+    const termpaint_surface *storage2 = surface2->view_parent ? surface2->view_parent : surface2;
+    const int x1 = surface1->view_parent ? surface1->view_x : 0;
+    const int y1 = surface1->view_parent ? surface1->view_y : 0;
+    const int x2 = surface2->view_parent ? surface2->view_x : 0;
+    const int y2 = surface2->view_parent ? surface2->view_y : 0;
+    if (storage1 == storage2 && x1 == x2 && y1 == y2) {
         return false;
     }
 
+    // Runs of cells with the same attributes are common, remember the last pair of attributes found to be equal.
+    uint32_t same_attr_id1 = ATTR_ID_NONE;
+    uint32_t same_attr_id2 = ATTR_ID_NONE;
+
     for (int y = 0; y < surface1->height; y++) {
+        const cell *row1 = &storage1->cells[(y + y1) * storage1->width + x1];
+        const cell *row2 = &storage2->cells[(y + y2) * storage2->width + x2];
         for (int x = 0; x < surface1->width; x++) {
-            if (termpaint_surface_peek_fg_color(surface1, x, y)
-                    != termpaint_surface_peek_fg_color(surface2, x, y)) {
-                return false;
-            }
-            if (termpaint_surface_peek_bg_color(surface1, x, y)
-                    != termpaint_surface_peek_bg_color(surface2, x, y)) {
-                return false;
-            }
-            if (termpaint_surface_peek_deco_color(surface1, x, y)
-                    != termpaint_surface_peek_deco_color(surface2, x, y)) {
-                return false;
-            }
-            if (termpaint_surface_peek_style(surface1, x, y)
-                    != termpaint_surface_peek_style(surface2, x, y)) {
-                return false;
-            }
-            if (termpaint_surface_peek_softwrap_marker(surface1, x, y)
-                    != termpaint_surface_peek_softwrap_marker(surface2, x, y)) {
-                return false;
-            }
-            {
-                const char *setup1, *setup2;
-                const char *cleanup1, *cleanup2;
-                bool optimize1, optimize2;
-                termpaint_surface_peek_patch(surface1, x, y, &setup1, &cleanup1, &optimize1);
-                termpaint_surface_peek_patch(surface2, x, y, &setup2, &cleanup2, &optimize2);
-
-                if ((setup1 == nullptr || setup2 == nullptr || strcmp(setup1, setup2) != 0) && !(setup1 == nullptr && setup2 == nullptr)) {
-                    return false;
-                }
-                if ((cleanup1 == nullptr || cleanup2 == nullptr || strcmp(cleanup1, cleanup2) != 0) && !(setup1 == nullptr && setup2 == nullptr)) {
-                    return false;
+            const cell *c1 = &row1[x];
+            const cell *c2 = &row2[x];
+            const bool padding1 = c1->text_len == 0 && c1->text_overflow == WIDE_RIGHT_PADDING;
+            const bool padding2 = c2->text_len == 0 && c2->text_overflow == WIDE_RIGHT_PADDING;
+            bool same;
+            if (x == 0 && (padding1 || padding2)) {
+                // the cluster starts left of a view
+                same = termpaintp_surface_same_cell_peek(surface1, surface2, x, y);
+            } else if (storage1 == storage2 && memcmp(c1, c2, sizeof(cell)) == 0) {
+                // bitwise identical cells of the same surface have the same text and attributes
+                same = true;
+            } else if (padding1 != padding2 || c1->flags != c2->flags) {
+                same = false;
+            } else {
+                same = true;
+                if (!padding1) {
+                    same = c1->cluster_expansion == c2->cluster_expansion;
+                    if (same && (c1->text_len != c2->text_len || memcmp(c1->text, c2->text, sizeof(c1->text)) != 0)) {
+                        // the same text might be stored differently, e.g. in overflow entries of different surfaces
+                        int len1, len2;
+                        const unsigned char *text1 = termpaintp_cell_text(c1, &len1);
+                        const unsigned char *text2 = termpaintp_cell_text(c2, &len2);
+                        same = len1 == len2 && memcmp(text1, text2, len1) == 0;
+                    }
                 }
-                if (optimize1 != optimize2) {
-                    return false;
+                if (same && (c1->attr_id != same_attr_id1 || c2->attr_id != same_attr_id2)) {
+                    same = termpaintp_same_attr(storage1, c1->attr_id, storage2, c2->attr_id);
+                    if (same) {
+                        same_attr_id1 = c1->attr_id;
+                        same_attr_id2 = c2->attr_id;
+                    }
                 }
             }
-            {
-                int left1, right1, len1;
-                int left2, right2, len2;
-                const char *text1 = termpaint_surface_peek_text(surface1, x, y, &len1, &left1, &right1);
-                const char *text2 = termpaint_surface_peek_text(surface2, x, y, &len2, &left2, &right2);
-
-                if (left1 != left2 || right1 != right2 || len1 != len2) {
-                    return false;
+            if (!same) {
+                if (x_out) {
+                    *x_out = x;
                 }
-                if (memcmp(text1, text2, len1) != 0) {
-                    return false;
+                if (y_out) {
+                    *y_out = y;
                 }
+                return true;
             }
         }
     }
 
-    return true;
+    return false;
+}
+
+bool termpaint_surface_same_contents(const termpaint_surface *surface1, const termpaint_surface *surface2) {
+    if (surface1 == surface2) {
+        return true;
+    }
+
+    return !termpaint_surface_find_difference(surface1, surface2, nullptr, nullptr);
 }
 
 
+// Damage is tracked by the surface owning the cells, views only select a part of it. Copy-on-write duplicates track
+// their own damage, their contents do not change while they share cells.
+static termpaint_surface *termpaintp_surface_damage_owner(const termpaint_surface *surface, int *x, int *y) {
+    if (surface->view_parent && !surface->cow_duplicate) {
+        *x = surface->view_x;
+        *y = surface->view_y;
+        return surface->view_parent;
+    }
+    *x = 0;
+    *y = 0;
+    return (termpaint_surface*)surface;
+}
+
+void termpaint_surface_damage_begin(termpaint_surface *surface) {
+    int x, y;
+    termpaint_surface *owner = termpaintp_surface_damage_owner(surface, &x, &y);
+    if (!owner->tracked_damage) {
+        // height can be 0, allocate at least one entry to keep the pointer non null
+        owner->tracked_damage = malloc((owner->height ? owner->height : 1) * sizeof(termpaintp_row_damage));
+        if (!owner->tracked_damage) {
+            termpaintp_oom(surface->terminal);
+        }
+        for (int y1 = 0; y1 < owner->height; y1++) {
+            owner->tracked_damage[y1].x0 = owner->width;
+            owner->tracked_damage[y1].x1 = -1;
+        }
+        return;
+    }
+    termpaintp_tracked_damage_reset(owner, x, y, surface->width, surface->height);
+}
+
+void termpaint_surface_damage_reset(termpaint_surface *surface) {
+    int x, y;
+    termpaint_surface *owner = termpaintp_surface_damage_owner(surface, &x, &y);
+    termpaintp_tracked_damage_reset(owner, x, y, surface->width, surface->height);
+}
+
+static inline void termpaintp_damage_emit(termpaint_rect *rects, int max_rects, int *count, const termpaint_rect *rect) {
+    if (*count < max_rects) {
+        rects[*count] = *rect;
+    }
+    ++*count;
+}
+
+int termpaint_surface_damage_collect(const termpaint_surface *surface, termpaint_rect *rects, int max_rects) {
+    int x, y;
+    const termpaint_surface *owner = termpaintp_surface_damage_owner(surface, &x, &y);
+    int count = 0;
+    if (surface->width <= 0 || surface->height <= 0) {
+        return 0;
+    }
+    if (!owner->tracked_damage) {
+        termpaint_rect all = { 0, 0, surface->width, surface->height };
+        termpaintp_damage_emit(rects, max_rects, &count, &all);
+        return count;
+    }
+
+    // Damaged ranges of consecutive rows are merged into one rectangle while they overlap and at least half of the
+    // merged rectangle is actually damaged.
+    termpaint_rect current = { 0, 0, 0, 0 };
+    int current_damaged = 0;
+    for (int y1 = 0; y1 < surface->height; y1++) {
+        const termpaintp_row_damage *damage = &owner->tracked_damage[y + y1];
+        const int x0 = (damage->x0 > x ? damage->x0 : x) - x;
+        const int x1 = (damage->x1 < x + surface->width - 1 ? damage->x1 : x + surface->width - 1) - x;
+        if (x1 < x0) {
+            if (current.height) {
+                termpaintp_damage_emit(rects, max_rects, &count, &current);
+                current.height = 0;
+            }
+            continue;
+        }
+        if (current.height) {
+            const int current_x1 = current.x + current.width - 1;
+            const int merged_x0 = x0 < current.x ? x0 : current.x;
+            const int merged_x1 = x1 > current_x1 ? x1 : current_x1;
+            const bool overlaps = x0 <= current_x1 && x1 >= current.x;
+            if (overlaps && (merged_x1 - merged_x0 + 1) * (current.height + 1)
+                                <= 2 * (current_damaged + x1 - x0 + 1)) {
+                current.x = merged_x0;
+                current.width = merged_x1 - merged_x0 + 1;
+                current.height++;
+                current_damaged += x1 - x0 + 1;
+                continue;
+            }
+            termpaintp_damage_emit(rects, max_rects, &count, &current);
+        }
+        current.x = x0;
+        current.y = y1;
+        current.width = x1 - x0 + 1;
+        current.height = 1;
+        current_damaged = x1 - x0 + 1;
+    }
+    if (current.height) {
+        termpaintp_damage_emit(rects, max_rects, &count, &current);
+    }
+    return count;
+}
+
 int termpaint_surface_char_width(const termpaint_surface *surface, int codepoint) {
     const termpaintp_width *char_width_table = surface->terminal->char_width_table;
     return termpaintp_char_width(char_width_table, codepoint);
 }
 
-static void int_puts(termpaint_integration *integration, const char *str) {
-    integration->p->write(integration, str, strlen(str));
+static void int_write(termpaint_integration *integration, const char *str, int len) {
+    integration->p->bytes_written += len;
+    integration->p->write(integration, str, len);
 }
 
-static void int_uputs(termpaint_integration *integration, const unsigned char *str) {
-    integration->p->write(integration, (const char*)str, ustrlen(str));
+static void int_puts(termpaint_integration *integration, const char *str) {
+    int_write(integration, str, strlen(str));
 }
 
-static void int_write(termpaint_integration *integration, const char *str, int len) {
-    integration->p->write(integration, str, len);
+static void int_uputs(termpaint_integration *integration, const unsigned char *str) {
+    int_write(integration, (const char*)str, ustrlen(str));
 }
 
 static void int_debuglog(termpaint_terminal *term, const char *str, int len) {
@@ -1851,11 +3177,11 @@ static void int_debuglog_printf(termpaint_terminal *term, const char *fmt, ...)
 static void int_put_num(termpaint_integration *integration, int num) {
     char buf[12];
     int len = sprintf(buf, "%d", num);
-    integration->p->write(integration, buf, len);
+    int_write(integration, buf, len);
 }
 
 static void int_put_tps(termpaint_integration *integration, const termpaint_str *tps) {
-    integration->p->write(integration, (const char*)tps->data, (int)tps->len);
+    int_write(integration, (const char*)tps->data, (int)tps->len);
 }
 
 static void int_awaiting_response(termpaint_integration *integration) {
@@ -2115,6 +3441,11 @@ static void termpaintp_terminal_reset_capabilites(termpaint_terminal *terminal)
     // Most terminals support support 7-bit ST (ESC backslash) for terminating OSC/DCS sequences,
     // as that's what all traditional standards say.
     termpaint_terminal_promise_capability(terminal, TERMPAINT_CAPABILITY_7BIT_ST);
+
+    // Repeating (REP) and synchronized updates (mode 2026) are less common extensions, so
+    // TERMPAINT_CAPABILITY_REPEAT_CHAR and TERMPAINT_CAPABILITY_SYNCHRONIZED_UPDATE are not promised here
+    // but only when detection identifies a terminal known to support REP or the terminal reports knowing
+    // mode 2026.
 }
 
 inline bool termpaint_terminal_capable(const termpaint_terminal *terminal, int capability) {
@@ -2136,6 +3467,11 @@ static void termpaintp_update_cache_from_capabilities(termpaint_terminal *termin
     terminal->cache_should_use_truecolor =
             termpaint_terminal_capable(terminal, TERMPAINT_CAPABILITY_TRUECOLOR_MAYBE_SUPPORTED)
             || termpaint_terminal_capable(terminal, TERMPAINT_CAPABILITY_TRUECOLOR_SUPPORTED);
+    // color quantization depends on capabilities, so what was sent in the last flush might be outdated now.
+    termpaintp_surface_damage_all(&terminal->primary);
+    terminal->quantization_changed = true;
+    memset(terminal->quantize_cache, 0, sizeof(terminal->quantize_cache));
+    termpaintp_attr_table_forget_quantized(&terminal->primary.attrs);
 }
 
 void termpaint_terminal_promise_capability(termpaint_terminal *terminal, int capability) {
@@ -2154,6 +3490,22 @@ void termpaint_terminal_disable_capability(termpaint_terminal *terminal, int cap
     termpaintp_update_cache_from_capabilities(terminal);
 }
 
+void termpaint_terminal_set_sgr_delta_encoding(termpaint_terminal *terminal, bool enabled) {
+    terminal->sgr_delta_encoding = enabled;
+}
+
+void termpaint_terminal_set_swap_buffers(termpaint_terminal *terminal, bool enabled) {
+    terminal->swap_buffers = enabled;
+}
+
+void termpaint_terminal_set_flush_budget(termpaint_terminal *terminal, int bytes) {
+    terminal->flush_budget = bytes > 0 ? bytes : 0;
+}
+
+bool termpaint_terminal_last_flush_partial(const termpaint_terminal *terminal) {
+    return terminal->last_flush_partial;
+}
+
 bool termpaint_terminal_should_use_truecolor(termpaint_terminal *terminal) {
     return terminal->cache_should_use_truecolor;
 }
@@ -2212,183 +3564,1012 @@ static uint32_t termpaintp_quantize_color(termpaint_terminal *term, uint32_t col
                 const int green_index = termpaintp_quantize_color_grid4(g);
                 const int blue_index = termpaintp_quantize_color_grid4(b);
 
-                const int red_quantized = termpaintp_grid4_values[red_index];
-                const int green_quantized = termpaintp_grid4_values[green_index];
-                const int blue_quantized = termpaintp_grid4_values[blue_index];
+                const int red_quantized = termpaintp_grid4_values[red_index];
+                const int green_quantized = termpaintp_grid4_values[green_index];
+                const int blue_quantized = termpaintp_grid4_values[blue_index];
+
+                color = TERMPAINT_INDEXED_COLOR + 16 + red_index * 16 + green_index * 4 + blue_index;
+#define SQ(x) ((x) * (x))
+                int best_metric = SQ(red_quantized - r) + SQ(green_quantized - g) + SQ(blue_quantized - b);
+
+                for (int grey_index = 0; grey_index < 8; grey_index++) {
+                    const int grey_quantized = termpaintp_ramp8_values[grey_index];
+                    const int cur_metric = SQ(grey_quantized - r) + SQ(grey_quantized - g) + SQ(grey_quantized - b);
+                    if (cur_metric < best_metric) {
+                        color = TERMPAINT_INDEXED_COLOR + 80 + grey_index;
+                        best_metric = cur_metric;
+                    }
+                }
+#undef SQ
+            } else {
+                // find nearest grey value in [8, 18, ..., 228, 238]
+                int grey_index = (((grey - 8)+5) / 10); // -3 / 10 rounds to zero, so grey == 0 still gives index 0
+                if (grey_index >= 24) {
+                    grey_index = 23;
+                }
+                const int grey_quantized = 8 + grey_index * 10;
+
+                // find nearest color on grid ((r,g,b) for r,b,g in [0, 95, 135, 175, 215, 255])
+                const int red_index = termpaintp_quantize_color_grid6(r);
+                const int green_index = termpaintp_quantize_color_grid6(g);
+                const int blue_index = termpaintp_quantize_color_grid6(b);
+
+                const int red_quantized = termpaintp_grid6_values[red_index];
+                const int green_quantized = termpaintp_grid6_values[green_index];
+                const int blue_quantized = termpaintp_grid6_values[blue_index];
+
+#define SQ(x) ((x) * (x))
+                if ((SQ(grey_quantized - r) + SQ(grey_quantized - g) + SQ(grey_quantized - b))
+                        < (SQ(red_quantized - r) + SQ(green_quantized - g) + SQ(blue_quantized - b))) {
+#undef SQ
+                    color = TERMPAINT_INDEXED_COLOR + 232 + grey_index;
+                } else {
+                    color = TERMPAINT_INDEXED_COLOR + 16
+                            + red_index * 36
+                            + green_index * 6
+                            + blue_index;
+                }
+            }
+        }
+    }
+    return color;
+}
+
+// Quantizing rgb colors is expensive, so remember results for recently used colors.
+static inline uint32_t termpaintp_quantize_color_cached(termpaint_terminal *term, uint32_t color) {
+    if (term->cache_should_use_truecolor || (color & 0xff000000) != TERMPAINT_RGB_COLOR_OFFSET) {
+        return color;
+    }
+    termpaintp_quantize_cache_entry *entry = &term->quantize_cache[(color * 2654435761u) >> 24];
+    if (entry->color != color) {
+        entry->color = color;
+        entry->quantized = termpaintp_quantize_color(term, color);
+    }
+    return entry->quantized;
+}
+
+// Returns the id of the attributes of the primary surface with the colors as sent to the terminal. Cells that look
+// the same on the terminal have the same quantized attribute id.
+static uint32_t termpaintp_terminal_quantized_attr(termpaint_terminal *term, uint32_t attr_id) {
+    termpaintp_attr_table *table = &term->primary.attrs;
+    uint32_t quantized_id = table->entries[attr_id].quantized_id;
+    if (quantized_id != ATTR_ID_NONE) {
+        return quantized_id;
+    }
+    termpaintp_attr_entry quantized = table->entries[attr_id];
+    quantized.fg_color = termpaintp_quantize_color_cached(term, quantized.fg_color);
+    quantized.bg_color = termpaintp_quantize_color_cached(term, quantized.bg_color);
+    if (!(quantized.flags & CELL_ATTR_DECO_MASK)) {
+        quantized.deco_color = TERMPAINT_DEFAULT_COLOR;
+    }
+    // attr_id is used by a cell, so it survives garbage collection while interning
+    quantized_id = termpaintp_surface_intern_attr(&term->primary, &quantized);
+    table->entries[attr_id].quantized_id = quantized_id;
+    table->entries[quantized_id].quantized_id = quantized_id;
+    return quantized_id;
+}
+
+typedef struct {
+    int index;
+    int max;
+} termpaintp_sgr_params;
+
+static inline void termpaintp_sgr_puts(termpaintp_sgr_buffer *out, const char *str) {
+    int len = strlen(str);
+    if (out->len + len > SGR_MAX_LEN) {
+        BUG("sgr sequence too long");
+    }
+    memcpy(out->data + out->len, str, len);
+    out->len += len;
+}
+
+static inline void termpaintp_sgr_put_num(termpaintp_sgr_buffer *out, int num) {
+    char buf[12];
+    sprintf(buf, "%d", num);
+    termpaintp_sgr_puts(out, buf);
+}
+
+static inline void write_color_sgr_values(termpaintp_sgr_buffer *out, termpaintp_sgr_params *params, uint32_t color, char *direct, char *indexed, char *sep, unsigned named, unsigned bright_named) {
+    if ((color & 0xff000000) == TERMPAINT_RGB_COLOR_OFFSET) {
+        if (params->index + 5 >= params->max) {
+            termpaintp_sgr_puts(out, "m\033[");
+            params->index = 0;
+            termpaintp_sgr_puts(out, direct + 1); // skip first ";"
+        } else {
+            termpaintp_sgr_puts(out, direct);
+        }
+        termpaintp_sgr_put_num(out, (color >> 16) & 0xff);
+        termpaintp_sgr_puts(out, sep);
+        termpaintp_sgr_put_num(out, (color >> 8) & 0xff);
+        termpaintp_sgr_puts(out, sep);
+        termpaintp_sgr_put_num(out, (color) & 0xff);
+        params->index += 5;
+    } else if (TERMPAINT_INDEXED_COLOR <= color && TERMPAINT_INDEXED_COLOR + 255 >= color) {
+        if (params->index + 3 >= params->max) {
+            termpaintp_sgr_puts(out, "m\033[");
+            params->index = 0;
+            termpaintp_sgr_puts(out, indexed + 1); // skip first ";"
+        } else {
+            termpaintp_sgr_puts(out, indexed);
+        }
+        termpaintp_sgr_put_num(out, (color) & 0xff);
+        params->index += 3;
+    } else {
+        if (named) {
+            if (TERMPAINT_NAMED_COLOR <= color && TERMPAINT_NAMED_COLOR + 7 >= color) {
+                if (params->index + 1 >= params->max) {
+                    termpaintp_sgr_puts(out, "m\033[");
+                    params->index = 0;
+                } else {
+                    termpaintp_sgr_puts(out, ";");
+                }
+                termpaintp_sgr_put_num(out, named + (color - TERMPAINT_NAMED_COLOR));
+                params->index += 1;
+            } else if (TERMPAINT_NAMED_COLOR + 8 <= color && TERMPAINT_NAMED_COLOR + 15 >= color) {
+                if (params->index + 1 >= params->max) {
+                    termpaintp_sgr_puts(out, "m\033[");
+                    params->index = 0;
+                } else {
+                    termpaintp_sgr_puts(out, ";");
+                }
+                termpaintp_sgr_put_num(out, bright_named + (color - (TERMPAINT_NAMED_COLOR + 8)));
+                params->index += 1;
+            }
+        } else {
+            if (TERMPAINT_NAMED_COLOR <= color && TERMPAINT_NAMED_COLOR + 15 >= color) {
+                if (params->index + 3 >= params->max) {
+                    termpaintp_sgr_puts(out, "m\033[");
+                    params->index = 0;
+                    termpaintp_sgr_puts(out, indexed + 1); // skip first ";"
+                } else {
+                    termpaintp_sgr_puts(out, indexed);
+                }
+                termpaintp_sgr_put_num(out, (color - TERMPAINT_NAMED_COLOR));
+                params->index += 3;
+            }
+        }
+    }
+}
+
+#define PUT_PARAMETER(s)                              \
+    do { if (params.index + 1 >= params.max) {        \
+        termpaintp_sgr_puts(out, "m\033[");            \
+        termpaintp_sgr_puts(out, ((const char*)s) + 1); \
+        params.index = 1;                             \
+    } else {                                          \
+        termpaintp_sgr_puts(out, s);                   \
+        params.index += 1;                            \
+    } } while (false)                                 \
+    /* end macro */
+
+static inline void termpaintp_sgr_put_underline(termpaintp_sgr_buffer *out, termpaintp_sgr_params *params,
+                                                uint32_t underline) {
+    if (underline == CELL_ATTR_UNDERLINE_SINGLE) {
+        if (params->index + 1 >= params->max) {
+            termpaintp_sgr_puts(out, "m\033[4");
+            params->index = 1;
+        } else {
+            termpaintp_sgr_puts(out, ";4");
+            params->index += 1;
+        }
+    } else if (underline == CELL_ATTR_UNDERLINE_DOUBLE) {
+        if (params->index + 1 >= params->max) {
+            termpaintp_sgr_puts(out, "m\033[21");
+            params->index = 1;
+        } else {
+            termpaintp_sgr_puts(out, ";21");
+            params->index += 1;
+        }
+    } else if (underline == CELL_ATTR_UNDERLINE_CURLY) {
+        // TODO maybe filter this by terminal capability somewhere?
+        if (params->index + 2 >= params->max) {
+            termpaintp_sgr_puts(out, "m\033[");
+            termpaintp_sgr_puts(out, "4:3");
+            params->index = 2;
+        } else {
+            termpaintp_sgr_puts(out, ";4:3");
+            params->index += 2;
+        }
+    }
+}
+
+static void termpaintp_sgr_serialize(termpaintp_sgr_buffer *out, int max_csi_parameters,
+                                     uint32_t bg, uint32_t fg, uint32_t deco, uint16_t flags) {
+    out->len = 0;
+    termpaintp_sgr_puts(out, "\033[0");
+    termpaintp_sgr_params params;
+    params.index = 1;
+    params.max = max_csi_parameters;
+    write_color_sgr_values(out, &params, bg, ";48;2;", ";48;5;", ";", 40, 100);
+    write_color_sgr_values(out, &params, fg, ";38;2;", ";38;5;", ";", 30, 90);
+    write_color_sgr_values(out, &params, deco, ";58:2:", ";58:5:", ":", 0, 0);
+    if (flags) {
+        if (flags & CELL_ATTR_BOLD) {
+            PUT_PARAMETER(";1");
+        }
+        if (flags & CELL_ATTR_ITALIC) {
+            PUT_PARAMETER(";3");
+        }
+        termpaintp_sgr_put_underline(out, &params, flags & CELL_ATTR_UNDERLINE_MASK);
+        if (flags & CELL_ATTR_BLINK) {
+            PUT_PARAMETER(";5");
+        }
+        if (flags & CELL_ATTR_OVERLINE) {
+            PUT_PARAMETER(";53");
+        }
+        if (flags & CELL_ATTR_INVERSE) {
+            PUT_PARAMETER(";7");
+        }
+        if (flags & CELL_ATTR_STRIKE) {
+            PUT_PARAMETER(";9");
+        }
+    }
+    termpaintp_sgr_puts(out, "m");
+}
+
+// Like termpaintp_sgr_serialize but assumes the terminal is known to have the cur_* attributes set and only
+// changes what differs. out->len is 0 if nothing differs.
+static void termpaintp_sgr_serialize_delta(termpaintp_sgr_buffer *out, int max_csi_parameters,
+                                           uint32_t cur_bg, uint32_t cur_fg, uint32_t cur_deco, uint16_t cur_flags,
+                                           uint32_t bg, uint32_t fg, uint32_t deco, uint16_t flags) {
+    out->len = 0;
+    termpaintp_sgr_puts(out, "\033[");
+    termpaintp_sgr_params params;
+    params.index = 0;
+    params.max = max_csi_parameters;
+    if (bg != cur_bg) {
+        if (bg == TERMPAINT_DEFAULT_COLOR) {
+            PUT_PARAMETER(";49");
+        } else {
+            write_color_sgr_values(out, &params, bg, ";48;2;", ";48;5;", ";", 40, 100);
+        }
+    }
+    if (fg != cur_fg) {
+        if (fg == TERMPAINT_DEFAULT_COLOR) {
+            PUT_PARAMETER(";39");
+        } else {
+            write_color_sgr_values(out, &params, fg, ";38;2;", ";38;5;", ";", 30, 90);
+        }
+    }
+    if (deco != cur_deco) {
+        if (deco == TERMPAINT_DEFAULT_COLOR) {
+            PUT_PARAMETER(";59");
+        } else {
+            write_color_sgr_values(out, &params, deco, ";58:2:", ";58:5:", ":", 0, 0);
+        }
+    }
+    const uint16_t removed = cur_flags & ~flags;
+    const uint16_t added = flags & ~cur_flags;
+    if (removed & CELL_ATTR_BOLD) {
+        PUT_PARAMETER(";22");
+    } else if (added & CELL_ATTR_BOLD) {
+        PUT_PARAMETER(";1");
+    }
+    if (removed & CELL_ATTR_ITALIC) {
+        PUT_PARAMETER(";23");
+    } else if (added & CELL_ATTR_ITALIC) {
+        PUT_PARAMETER(";3");
+    }
+    const uint32_t underline = flags & CELL_ATTR_UNDERLINE_MASK;
+    if (underline != (cur_flags & CELL_ATTR_UNDERLINE_MASK)) {
+        if (underline) {
+            termpaintp_sgr_put_underline(out, &params, underline);
+        } else {
+            PUT_PARAMETER(";24");
+        }
+    }
+    if (removed & CELL_ATTR_BLINK) {
+        PUT_PARAMETER(";25");
+    } else if (added & CELL_ATTR_BLINK) {
+        PUT_PARAMETER(";5");
+    }
+    if (removed & CELL_ATTR_OVERLINE) {
+        PUT_PARAMETER(";55");
+    } else if (added & CELL_ATTR_OVERLINE) {
+        PUT_PARAMETER(";53");
+    }
+    if (removed & CELL_ATTR_INVERSE) {
+        PUT_PARAMETER(";27");
+    } else if (added & CELL_ATTR_INVERSE) {
+        PUT_PARAMETER(";7");
+    }
+    if (removed & CELL_ATTR_STRIKE) {
+        PUT_PARAMETER(";29");
+    } else if (added & CELL_ATTR_STRIKE) {
+        PUT_PARAMETER(";9");
+    }
+    if (out->len == 2) {
+        // nothing to change, "\033[m" would reset everything
+        out->len = 0;
+        return;
+    }
+    termpaintp_sgr_puts(out, "m");
+    if (out->data[2] == ';') {
+        // first parameter does not need a separator
+        memmove(out->data + 2, out->data + 3, out->len - 3);
+        out->len -= 1;
+    }
+}
+#undef PUT_PARAMETER
+
+static const termpaintp_sgr_cache_entry *termpaintp_terminal_sgr_lookup(termpaint_terminal *term, uint32_t bg,
+                                                                        uint32_t fg, uint32_t deco, uint16_t flags) {
+    if (term->sgr_cache_tick == UINT32_MAX) {
+        // start over instead of breaking lru order
+        memset(term->sgr_cache, 0, sizeof(term->sgr_cache));
+        term->sgr_cache_tick = 0;
+    }
+    const unsigned set = ((bg * 0x9e3779b1u) ^ (fg * 0x85ebca77u) ^ (deco * 0xc2b2ae3du) ^ (flags * 0x27d4eb2fu))
+                          % SGR_CACHE_SETS;
+    termpaintp_sgr_cache_entry *entries = &term->sgr_cache[set * SGR_CACHE_WAYS];
+    termpaintp_sgr_cache_entry *victim = entries;
+    for (int i = 0; i < SGR_CACHE_WAYS; i++) {
+        termpaintp_sgr_cache_entry *entry = &entries[i];
+        if (entry->last_used && entry->bg == bg && entry->fg == fg && entry->deco == deco && entry->flags == flags) {
+            entry->last_used = ++term->sgr_cache_tick;
+            return entry;
+        }
+        if (entry->last_used < victim->last_used) {
+            victim = entry;
+        }
+    }
+    // evict least recently used entry of this set
+    victim->bg = bg;
+    victim->fg = fg;
+    victim->deco = deco;
+    victim->flags = flags;
+    victim->last_used = ++term->sgr_cache_tick;
+    termpaintp_sgr_serialize(&victim->sgr, term->max_csi_parameters, bg, fg, deco, flags);
+    return victim;
+}
+
+// Returns the number of leading cells that are bitwise identical in both arrays.
+static int termpaintp_count_identical_cells(const cell *a, const cell *b, int count) {
+    int i = 0;
+#ifdef __SSE2__
+    // a cell is exactly 16 bytes, so each vector compares one whole cell
+    _Static_assert(sizeof(cell) == sizeof(__m128i), "cell size does not match vector size");
+    const char *pa = (const char*)a;
+    const char *pb = (const char*)b;
+    for (; i < count; i++) {
+        __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(const void*)(pa + i * sizeof(cell))),
+                                    _mm_loadu_si128((const __m128i*)(const void*)(pb + i * sizeof(cell))));
+        if (_mm_movemask_epi8(eq) != 0xffff) {
+            break;
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        if (memcmp(&a[i], &b[i], sizeof(cell)) != 0) {
+            break;
+        }
+    }
+    return i;
+}
+
+// Marks what the terminal displays in row y as unknown, so the next flush repaints the whole row.
+static void termpaintp_terminal_forget_row(termpaint_terminal *term, int y) {
+    termpaint_surface *surface = &term->primary;
+    for (int x = 0; x < surface->width; x++) {
+        cell *old_c = &surface->cells_last_flush[y * surface->width + x];
+        memset(old_c, 0, sizeof(cell));
+        old_c->text_len = 1;
+        old_c->text[0] = '\x01';
+    }
+    termpaintp_surface_damage(surface, y, 0, surface->width - 1);
+}
+
+// Returns true if row y of the primary surface would not need any painting if the terminal displayed row y_last
+// of the last flush in its place.
+static bool termpaintp_terminal_row_matches_last_flush(termpaint_terminal *term, int y, int y_last) {
+    termpaint_surface *surface = &term->primary;
+    for (int x = 0; x < surface->width; x++) {
+        const cell *c = &surface->cells[y * surface->width + x];
+        const cell *old_c = &surface->cells_last_flush[y_last * surface->width + x];
+        if (c->text_len != old_c->text_len) {
+            return false;
+        }
+        if (c->text_len) {
+            if (memcmp(c->text, old_c->text, c->text_len) != 0) {
+                return false;
+            }
+        } else if (c->text_overflow != old_c->text_overflow) {
+            return false;
+        }
+        if (c->flags != old_c->flags
+                || termpaintp_terminal_quantized_attr(term, c->attr_id)
+                   != termpaintp_terminal_quantized_attr(term, old_c->attr_id)) {
+            return false;
+        }
+        x += c->cluster_expansion;
+    }
+    return true;
+}
+
+static inline uint32_t termpaintp_row_hash_step(uint32_t hash, uint32_t value) {
+    return (hash ^ value) * 16777619u;
+}
+
+// Hash of a row that is consistent with termpaintp_terminal_row_matches_last_flush. Attributes are quantized, which
+// is a no-op for rows from the last flush.
+static uint32_t termpaintp_terminal_row_hash(termpaint_terminal *term, const cell *row, int width) {
+    uint32_t hash = 2166136261u;
+    for (int x = 0; x < width; x++) {
+        const cell *c = &row[x];
+        hash = termpaintp_row_hash_step(hash, c->text_len);
+        if (c->text_len) {
+            for (int i = 0; i < c->text_len; i++) {
+                hash = termpaintp_row_hash_step(hash, c->text[i]);
+            }
+        } else {
+            hash = termpaintp_row_hash_step(hash, (uint32_t)(uintptr_t)c->text_overflow);
+        }
+        hash = termpaintp_row_hash_step(hash, c->flags);
+        hash = termpaintp_row_hash_step(hash, termpaintp_terminal_quantized_attr(term, c->attr_id));
+        x += c->cluster_expansion;
+    }
+    return hash;
+}
+
+#define SCROLL_MAX_CANDIDATES 16
+
+// When rows moved up or down as a block since the last flush (e.g. scrolling in a log view) let the terminal
+// move them using a scroll region and DL/IL instead of repainting every moved row. Adjusts cells_last_flush and
+// the row damage to the new terminal state, so the following flush only paints the rows that scrolled in.
+// Only a single region is scrolled per flush. Returns true if a region was scrolled.
+static bool termpaintp_terminal_scroll_optimize(termpaint_terminal *term) {
+    termpaint_surface *surface = &term->primary;
+    const int width = surface->width;
+    const int height = surface->height;
+
+    if (height < 3 || width < 1 || !surface->row_damage) {
+        return false;
+    }
+
+    int damaged_rows = 0;
+    for (int y = 0; y < height; y++) {
+        if (surface->row_damage[y].x0 <= surface->row_damage[y].x1) {
+            damaged_rows++;
+        }
+    }
+    if (damaged_rows < 2) {
+        return false;
+    }
+
+    // This is just an optimization, so silently skip it on allocation failure.
+    uint32_t *hashes = malloc(2 * (size_t)height * sizeof(uint32_t));
+    if (!hashes) {
+        return false;
+    }
+    uint32_t *cur_hash = hashes;
+    uint32_t *old_hash = hashes + height;
+
+    for (int y = 0; y < height; y++) {
+        old_hash[y] = termpaintp_terminal_row_hash(term, &surface->cells_last_flush[y * width], width);
+        if (surface->row_damage[y].x0 <= surface->row_damage[y].x1) {
+            cur_hash[y] = termpaintp_terminal_row_hash(term, &surface->cells[y * width], width);
+        } else {
+            cur_hash[y] = old_hash[y];
+        }
+    }
+
+    // Collect candidate shifts from the first few changed rows. A shift d means row y now shows what was in row
+    // y + d in the last flush.
+    int candidates[SCROLL_MAX_CANDIDATES];
+    int num_candidates = 0;
+    int changed_rows_considered = 0;
+    for (int y = 0; y < height && changed_rows_considered < 3 && num_candidates < SCROLL_MAX_CANDIDATES; y++) {
+        if (cur_hash[y] == old_hash[y]) {
+            continue;
+        }
+        changed_rows_considered++;
+        for (int y_old = 0; y_old < height && num_candidates < SCROLL_MAX_CANDIDATES; y_old++) {
+            if (y_old == y || old_hash[y_old] != cur_hash[y]) {
+                continue;
+            }
+            int d = y_old - y;
+            bool known = false;
+            for (int i = 0; i < num_candidates; i++) {
+                known |= candidates[i] == d;
+            }
+            if (!known) {
+                candidates[num_candidates++] = d;
+            }
+        }
+    }
+
+    // For each candidate find the longest run of rows that match shifted rows. Score is the number of rows that
+    // would no longer need repainting minus the number of unchanged rows that would be exposed by the scroll.
+    int best_score = 0, best_d = 0, best_first = 0, best_last = -1;
+    for (int i = 0; i < num_candidates; i++) {
+        const int d = candidates[i];
+        const int y_min = d > 0 ? 0 : -d;
+        const int y_max = d > 0 ? height - 1 - d : height - 1;
+        int run_first = -1;
+        int saved = 0;
+        for (int y = y_min; y <= y_max + 1; y++) {
+            if (y <= y_max && cur_hash[y] == old_hash[y + d]) {
+                if (run_first == -1) {
+                    run_first = y;
+                    saved = 0;
+                }
+                if (cur_hash[y] != old_hash[y]) {
+                    saved++;
+                }
+                continue;
+            }
+            if (run_first == -1) {
+                continue;
+            }
+            int run_last = y - 1;
+            int exposed_first = d > 0 ? run_last + 1 : run_first + d;
+            int exposed_last = d > 0 ? run_last + d : run_first - 1;
+            int score = saved;
+            for (int e = exposed_first; e <= exposed_last; e++) {
+                if (cur_hash[e] == old_hash[e]) {
+                    score--;
+                }
+            }
+            if (score > best_score) {
+                best_score = score;
+                best_d = d;
+                best_first = run_first;
+                best_last = run_last;
+            }
+            run_first = -1;
+        }
+    }
+
+    free(hashes);
 
-                color = TERMPAINT_INDEXED_COLOR + 16 + red_index * 16 + green_index * 4 + blue_index;
-#define SQ(x) ((x) * (x))
-                int best_metric = SQ(red_quantized - r) + SQ(green_quantized - g) + SQ(blue_quantized - b);
+    // Setting up and resetting the scroll region costs about as much as painting a short row.
+    if (best_score < 2) {
+        return false;
+    }
 
-                for (int grey_index = 0; grey_index < 8; grey_index++) {
-                    const int grey_quantized = termpaintp_ramp8_values[grey_index];
-                    const int cur_metric = SQ(grey_quantized - r) + SQ(grey_quantized - g) + SQ(grey_quantized - b);
-                    if (cur_metric < best_metric) {
-                        color = TERMPAINT_INDEXED_COLOR + 80 + grey_index;
-                        best_metric = cur_metric;
-                    }
-                }
-#undef SQ
-            } else {
-                // find nearest grey value in [8, 18, ..., 228, 238]
-                int grey_index = (((grey - 8)+5) / 10); // -3 / 10 rounds to zero, so grey == 0 still gives index 0
-                if (grey_index >= 24) {
-                    grey_index = 23;
-                }
-                const int grey_quantized = 8 + grey_index * 10;
+    for (int y = best_first; y <= best_last; y++) {
+        if (!termpaintp_terminal_row_matches_last_flush(term, y, y + best_d)) {
+            // hash collision, give up
+            return false;
+        }
+    }
 
-                // find nearest color on grid ((r,g,b) for r,b,g in [0, 95, 135, 175, 215, 255])
-                const int red_index = termpaintp_quantize_color_grid6(r);
-                const int green_index = termpaintp_quantize_color_grid6(g);
-                const int blue_index = termpaintp_quantize_color_grid6(b);
+    const int top = best_d > 0 ? best_first : best_first + best_d;
+    const int bottom = best_d > 0 ? best_last + best_d : best_last;
+    const int lines = best_d > 0 ? best_d : -best_d;
 
-                const int red_quantized = termpaintp_grid6_values[red_index];
-                const int green_quantized = termpaintp_grid6_values[green_index];
-                const int blue_quantized = termpaintp_grid6_values[blue_index];
+    termpaint_integration *integration = term->integration;
+    int_puts(integration, "\033[");
+    int_put_num(integration, top + 1);
+    int_puts(integration, ";");
+    int_put_num(integration, bottom + 1);
+    int_puts(integration, "r\033[");
+    int_put_num(integration, top + 1);
+    int_puts(integration, "H\033[");
+    int_put_num(integration, lines);
+    int_puts(integration, best_d > 0 ? "M" : "L");
+    int_puts(integration, "\033[r");
+
+    cell *region = &surface->cells_last_flush[top * width];
+    const int moved_rows = bottom - top + 1 - lines;
+    int exposed_first;
+    if (best_d > 0) {
+        memmove(region, region + lines * width, (size_t)moved_rows * width * sizeof(cell));
+        exposed_first = top + moved_rows;
+    } else {
+        memmove(region + lines * width, region, (size_t)moved_rows * width * sizeof(cell));
+        exposed_first = top;
+    }
+    for (int y = exposed_first; y < exposed_first + lines; y++) {
+        termpaintp_terminal_forget_row(term, y);
+    }
+    for (int y = top; y <= bottom; y++) {
+        termpaintp_surface_damage(surface, y, 0, width - 1);
+    }
+    return true;
+}
 
-#define SQ(x) ((x) * (x))
-                if ((SQ(grey_quantized - r) + SQ(grey_quantized - g) + SQ(grey_quantized - b))
-                        < (SQ(red_quantized - r) + SQ(green_quantized - g) + SQ(blue_quantized - b))) {
-#undef SQ
-                    color = TERMPAINT_INDEXED_COLOR + 232 + grey_index;
-                } else {
-                    color = TERMPAINT_INDEXED_COLOR + 16
-                            + red_index * 36
-                            + green_index * 6
-                            + blue_index;
-                }
+static int termpaintp_num_digits(int num) {
+    int digits = 1;
+    while (num >= 10) {
+        num /= 10;
+        digits++;
+    }
+    return digits;
+}
+
+// Returns the number of cells directly following x in row y (but before x_limit) that have exactly the same
+// contents and look the same on the terminal as the single width cell at x.
+static int termpaintp_terminal_count_repeatable(termpaint_terminal *term, int x, int y, int x_limit) {
+    const cell *c = termpaintp_getcell(&term->primary, x, y);
+    const uint32_t quantized_id = termpaintp_terminal_quantized_attr(term, c->attr_id);
+    int count = 0;
+    for (int x2 = x + 1; x2 < x_limit; x2++) {
+        const cell *c2 = termpaintp_getcell(&term->primary, x2, y);
+        if (c2->text_len != c->text_len || c2->cluster_expansion != 0
+                || termpaintp_terminal_quantized_attr(term, c2->attr_id) != quantized_id) {
+            break;
+        }
+        if (c->text_len) {
+            if (memcmp(c2->text, c->text, c->text_len) != 0) {
+                break;
             }
+        } else if (c2->text_overflow != c->text_overflow) {
+            break;
         }
+        count++;
+    }
+    return count;
+}
+
+// Where flush knows the terminal cursor to be. The cursor is in wrap pending state after printing into the last
+// column, in this state only absolute column movement or carriage return has portable results.
+typedef struct termpaintp_flush_cursor_ {
+    bool known;
+    bool wrap_pending;
+    int x;
+    int y;
+    // In the current row the cells from reprint_x up to the cell currently processed are unchanged and can be
+    // printed again without attribute changes to move the cursor. reprint_bytes is the length of their text
+    // or -1 if this is not possible.
+    int reprint_x;
+    int reprint_bytes;
+} termpaintp_flush_cursor;
+
+enum { MOVE_COL_NONE, MOVE_COL_CUF, MOVE_COL_CUB, MOVE_COL_CHA, MOVE_COL_REPRINT };
+enum { MOVE_ROW_NONE, MOVE_ROW_LF, MOVE_ROW_CUD, MOVE_ROW_CUU, MOVE_ROW_VPA, MOVE_ROW_CUP };
+
+static inline int termpaintp_csi_cost(int num, int default_num) {
+    // ESC [ num final, with num omitted if it is the default
+    return num == default_num ? 3 : 3 + termpaintp_num_digits(num);
+}
+
+// Returns the cheapest way in bytes to move in the current row from from_x to to_x without carriage return.
+static int termpaintp_flush_column_cost(const termpaintp_flush_cursor *cursor, int from_x, bool wrap_pending,
+                                        int to_x, int *method) {
+    int best = termpaintp_csi_cost(to_x + 1, 1);
+    *method = MOVE_COL_CHA;
+    if (wrap_pending) {
+        return best;
+    }
+    if (from_x == to_x) {
+        *method = MOVE_COL_NONE;
+        return 0;
     }
-    return color;
+    if (from_x < to_x) {
+        int cost = termpaintp_csi_cost(to_x - from_x, 1);
+        if (cost < best) {
+            best = cost;
+            *method = MOVE_COL_CUF;
+        }
+        if (from_x == cursor->reprint_x && cursor->reprint_bytes >= 0 && cursor->reprint_bytes < best) {
+            best = cursor->reprint_bytes;
+            *method = MOVE_COL_REPRINT;
+        }
+    } else {
+        int cost = termpaintp_csi_cost(from_x - to_x, 1);
+        if (cost < best) {
+            best = cost;
+            *method = MOVE_COL_CUB;
+        }
+    }
+    return best;
 }
 
-typedef struct {
-    int index;
-    int max;
-} termpaintp_sgr_params;
+static void termpaintp_flush_put_csi(termpaint_integration *integration, int num, int default_num, const char *final) {
+    int_puts(integration, "\033[");
+    if (num != default_num) {
+        int_put_num(integration, num);
+    }
+    int_puts(integration, final);
+}
 
-static inline void write_color_sgr_values(termpaint_integration *integration, termpaintp_sgr_params *params, uint32_t color, char *direct, char *indexed, char *sep, unsigned named, unsigned bright_named) {
-    if ((color & 0xff000000) == TERMPAINT_RGB_COLOR_OFFSET) {
-        if (params->index + 5 >= params->max) {
-            int_puts(integration, "m\033[");
-            params->index = 0;
-            int_puts(integration, direct + 1); // skip first ";"
-        } else {
-            int_puts(integration, direct);
+// Moves the terminal cursor to x, y choosing the sequence with the least bytes from absolute positioning (CUP),
+// line feeds, relative movement (CUD, CUU, CUF, CUB), absolute row or column movement (VPA, CHA), carriage return
+// and reprinting unchanged cells. The cursor moves up when a flush resumed after a flush budget wraps around to
+// the top rows.
+static void termpaintp_flush_move_cursor(termpaint_terminal *term, termpaintp_flush_cursor *cursor, int x, int y) {
+    termpaint_integration *integration = term->integration;
+
+    if (cursor->known && !cursor->wrap_pending && cursor->x == x && cursor->y == y) {
+        return;
+    }
+
+    int best_cost = 3 + termpaintp_num_digits(y + 1) + (x ? 1 + termpaintp_num_digits(x + 1) : 0);
+    int best_row = MOVE_ROW_CUP;
+    bool best_cr = false;
+    int best_col = MOVE_COL_NONE;
+
+    if (cursor->known) {
+        const int rows = y - cursor->y;
+        int col_method;
+        int cost;
+        // row movement without carriage return or line feed, VPA is only shorter when moving up
+        int row_method = rows > 0 ? MOVE_ROW_CUD : MOVE_ROW_CUU;
+        int row_cost = termpaintp_csi_cost(rows > 0 ? rows : -rows, 1);
+        if (termpaintp_csi_cost(y + 1, 1) < row_cost) {
+            row_method = MOVE_ROW_VPA;
+            row_cost = termpaintp_csi_cost(y + 1, 1);
         }
-        int_put_num(integration, (color >> 16) & 0xff);
-        int_puts(integration, sep);
-        int_put_num(integration, (color >> 8) & 0xff);
-        int_puts(integration, sep);
-        int_put_num(integration, (color) & 0xff);
-        params->index += 5;
-    } else if (TERMPAINT_INDEXED_COLOR <= color && TERMPAINT_INDEXED_COLOR + 255 >= color) {
-        if (params->index + 3 >= params->max) {
-            int_puts(integration, "m\033[");
-            params->index = 0;
-            int_puts(integration, indexed + 1); // skip first ";"
+        // moves that keep the column
+        int keep_col_cost = termpaintp_flush_column_cost(cursor, cursor->x, cursor->wrap_pending, x, &col_method);
+        if (rows == 0) {
+            cost = keep_col_cost;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_row = MOVE_ROW_NONE;
+                best_cr = false;
+                best_col = col_method;
+            }
+        } else if (!cursor->wrap_pending) {
+            cost = row_cost + keep_col_cost;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_row = row_method;
+                best_cr = false;
+                best_col = col_method;
+            }
+        }
+        // moves starting with carriage return
+        int cr_col_cost = 1 + termpaintp_flush_column_cost(cursor, 0, false, x, &col_method);
+        if (rows == 0) {
+            cost = cr_col_cost;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_row = MOVE_ROW_NONE;
+                best_cr = true;
+                best_col = col_method;
+            }
         } else {
-            int_puts(integration, indexed);
+            if (rows > 0) {
+                cost = rows + cr_col_cost;
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_row = MOVE_ROW_LF;
+                    best_cr = true;
+                    best_col = col_method;
+                }
+            }
+            cost = row_cost + cr_col_cost;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_row = row_method;
+                best_cr = true;
+                best_col = col_method;
+            }
         }
-        int_put_num(integration, (color) & 0xff);
-        params->index += 3;
+    }
+
+    if (best_row == MOVE_ROW_CUP) {
+        int_puts(integration, "\033[");
+        int_put_num(integration, y + 1);
+        if (x) {
+            int_puts(integration, ";");
+            int_put_num(integration, x + 1);
+        }
+        int_puts(integration, "H");
     } else {
-        if (named) {
-            if (TERMPAINT_NAMED_COLOR <= color && TERMPAINT_NAMED_COLOR + 7 >= color) {
-                if (params->index + 1 >= params->max) {
-                    int_puts(integration, "m\033[");
-                    params->index = 0;
-                } else {
-                    int_puts(integration, ";");
-                }
-                int_put_num(integration, named + (color - TERMPAINT_NAMED_COLOR));
-                params->index += 1;
-            } else if (TERMPAINT_NAMED_COLOR + 8 <= color && TERMPAINT_NAMED_COLOR + 15 >= color) {
-                if (params->index + 1 >= params->max) {
-                    int_puts(integration, "m\033[");
-                    params->index = 0;
+        int from_x = cursor->x;
+        if (best_cr) {
+            int_puts(integration, "\r");
+            from_x = 0;
+        }
+        if (best_row == MOVE_ROW_LF) {
+            for (int i = cursor->y; i < y; i++) {
+                int_puts(integration, "\n");
+            }
+        } else if (best_row == MOVE_ROW_CUD) {
+            termpaintp_flush_put_csi(integration, y - cursor->y, 1, "B");
+        } else if (best_row == MOVE_ROW_CUU) {
+            termpaintp_flush_put_csi(integration, cursor->y - y, 1, "A");
+        } else if (best_row == MOVE_ROW_VPA) {
+            termpaintp_flush_put_csi(integration, y + 1, 1, "d");
+        }
+        if (best_col == MOVE_COL_CUF) {
+            termpaintp_flush_put_csi(integration, x - from_x, 1, "C");
+        } else if (best_col == MOVE_COL_CUB) {
+            termpaintp_flush_put_csi(integration, from_x - x, 1, "D");
+        } else if (best_col == MOVE_COL_CHA) {
+            termpaintp_flush_put_csi(integration, x + 1, 1, "G");
+        } else if (best_col == MOVE_COL_REPRINT) {
+            for (int i = from_x; i < x; i++) {
+                const cell *c = termpaintp_getcell(&term->primary, i, y);
+                if (c->text_len) {
+                    int_write(integration, (const char*)c->text, c->text_len);
+                } else if (c->text_overflow == nullptr) {
+                    int_puts(integration, " ");
                 } else {
-                    int_puts(integration, ";");
+                    int_uputs(integration, c->text_overflow->text);
                 }
-                int_put_num(integration, bright_named + (color - (TERMPAINT_NAMED_COLOR + 8)));
-                params->index += 1;
+                i += c->cluster_expansion;
             }
-        } else {
-            if (TERMPAINT_NAMED_COLOR <= color && TERMPAINT_NAMED_COLOR + 15 >= color) {
-                if (params->index + 3 >= params->max) {
-                    int_puts(integration, "m\033[");
-                    params->index = 0;
-                    int_puts(integration, indexed + 1); // skip first ";"
-                } else {
-                    int_puts(integration, indexed);
+        }
+    }
+
+    cursor->known = true;
+    cursor->wrap_pending = false;
+    cursor->x = x;
+    cursor->y = y;
+}
+
+// Updates the cursor state after printing a cluster of width columns starting at x in row y.
+static inline void termpaintp_flush_cursor_printed(termpaint_terminal *term, termpaintp_flush_cursor *cursor,
+                                                   int x, int y, int width) {
+    cursor->known = true;
+    cursor->y = y;
+    if (x + width >= term->primary.width) {
+        cursor->x = term->primary.width - 1;
+        cursor->wrap_pending = true;
+    } else {
+        cursor->x = x + width;
+        cursor->wrap_pending = false;
+    }
+    cursor->reprint_x = cursor->x;
+    cursor->reprint_bytes = cursor->wrap_pending ? -1 : 0;
+}
+
+enum { sw_no, sw_single, sw_double };
+
+// Returns how row y is soft wrapped into the next row.
+static int termpaintp_flush_row_softwrap(termpaint_terminal *term, int y) {
+    int softwrap = sw_no;
+    if (y+1 < term->primary.height && term->primary.width) {
+        cell* first_next_line = termpaintp_getcell(&term->primary, 0, y + 1);
+        if (first_next_line->flags & CELL_SOFTWRAP_MARKER
+                && (first_next_line->text_len || first_next_line->text_overflow != nullptr)) {
+
+            cell* last_this_line = termpaintp_getcell(&term->primary, term->primary.width - 1, y);
+            if (last_this_line->flags & CELL_SOFTWRAP_MARKER
+                    && (last_this_line->text_len || last_this_line->text_overflow != nullptr)) {
+                softwrap = sw_single;
+            } else if (last_this_line->text_len == 0
+                       && last_this_line->text_overflow == nullptr
+                       && term->primary.width >= 2) {
+                last_this_line = termpaintp_getcell(&term->primary, term->primary.width - 2, y);
+                if (last_this_line->flags & CELL_SOFTWRAP_MARKER
+                        && (last_this_line->text_len || last_this_line->text_overflow != nullptr)
+                        && first_next_line->cluster_expansion == 1) {
+                    softwrap = sw_double;
                 }
-                int_put_num(integration, (color - TERMPAINT_NAMED_COLOR));
-                params->index += 3;
             }
         }
     }
+    return softwrap;
+}
+
+// Converts the colors in cells_last_flush of the primary surface from the raw colors saved by swapping buffers to
+// the quantized colors that flush saves otherwise.
+static void termpaintp_terminal_quantize_last_flush(termpaint_terminal *term) {
+    termpaint_surface *surface = &term->primary;
+    for (int i = 0; i < surface->width * surface->height; i++) {
+        cell *old_c = &surface->cells_last_flush[i];
+        old_c->attr_id = termpaintp_terminal_quantized_attr(term, old_c->attr_id);
+    }
+    term->cells_last_flush_raw = false;
+}
+
+// After a flush all cells are painted, so the current contents of the primary surface are exactly what
+// cells_last_flush needs to contain. Instead of copying them swap the buffers and leave the previous contents in the
+// primary surface. The previous contents are only usable as surface contents if they are a plain copy of an earlier
+// frame, otherwise (and if scroll optimization moved rows in cells_last_flush) copy once.
+static void termpaintp_terminal_swap_buffers(termpaint_terminal *term, bool scrolled) {
+    termpaint_surface *surface = &term->primary;
+    if (!term->cells_last_flush_raw || scrolled) {
+        memcpy(surface->cells_last_flush, surface->cells, (size_t)surface->width * surface->height * sizeof(cell));
+        term->cells_last_flush_raw = true;
+        return;
+    }
+    termpaintp_surface_prepare_write(surface);
+    cell *tmp = surface->cells;
+    surface->cells = surface->cells_last_flush;
+    surface->cells_last_flush = tmp;
+    termpaintp_surface_damage_all(surface);
+    for (int y = 0; y < surface->height && surface->tracked_damage; y++) {
+        surface->tracked_damage[y].x0 = 0;
+        surface->tracked_damage[y].x1 = surface->width - 1;
+    }
 }
 
 void termpaint_terminal_flush(termpaint_terminal *term, bool full_repaint) {
     termpaint_integration *integration = term->integration;
     full_repaint |= term->force_full_repaint;
+    term->force_full_repaint = false;
+    // Swapping requires that all changes are painted in this flush.
+    const bool swap_buffers = term->swap_buffers && !term->flush_budget;
+    if (term->cells_last_flush_raw) {
+        if (term->quantization_changed) {
+            // the last flush used another quantization, which is not recorded with raw colors.
+            full_repaint = true;
+        } else if (!swap_buffers) {
+            termpaintp_terminal_quantize_last_flush(term);
+        }
+    }
+    // Cells that are bitwise identical to the last flush don't need to be painted, but only if color quantization
+    // did not change. In the last flush cell colors were saved after quantization.
+    const bool skip_identical = !full_repaint && !term->quantization_changed;
+    term->quantization_changed = false;
+    term->last_flush_partial = false;
+    const size_t bytes_written_start = integration->p->bytes_written;
+    const bool synchronized_update = termpaint_terminal_capable(term, TERMPAINT_CAPABILITY_SYNCHRONIZED_UPDATE);
+    if (synchronized_update) {
+        // ask the terminal to only render the completed frame
+        int_puts(integration, "\033[?2026h");
+    }
     termpaintp_terminal_hide_cursor(term);
-    int_puts(integration, "\033[H");
-    char speculation_buffer[30];
-    int speculation_buffer_state = 0; // 0 = cursor position matches current cell, -1 = force move, > 0 bytes to print instead of move
-    int pending_row_move = 0;
-    int pending_colum_move = 0;
-    int pending_colum_move_digits = 1;
-    int pending_colum_move_digits_step = 10;
+    bool scrolled = false;
+    if (skip_identical && termpaint_terminal_capable(term, TERMPAINT_CAPABILITY_SCROLL_REGION)) {
+        scrolled = termpaintp_terminal_scroll_optimize(term);
+    }
+    const bool old_colors_raw = term->cells_last_flush_raw;
+    termpaintp_flush_cursor cursor;
+    cursor.known = false;
+    cursor.wrap_pending = false;
+    cursor.x = 0;
+    cursor.y = 0;
+    // reprinting is never used if it costs more than absolute positioning
+    const int max_move_cost = 4 + termpaintp_num_digits(term->primary.height) + termpaintp_num_digits(term->primary.width);
+    const bool cleared_coloring = termpaint_terminal_capable(term, TERMPAINT_CAPABILITY_CLEARED_COLORING);
     const bool cleared_defcolor = termpaint_terminal_capable(term, TERMPAINT_CAPABILITY_CLEARED_COLORING_DEFCOLOR);
+    const bool repeat_char = termpaint_terminal_capable(term, TERMPAINT_CAPABILITY_REPEAT_CHAR);
 
-    enum { sw_no, sw_single, sw_double } softwrap_prev = sw_no, softwrap = sw_no;
-
-    for (int y = 0; y < term->primary.height; y++) {
-        speculation_buffer_state = 0;
-        pending_colum_move = 0;
-        pending_colum_move_digits = 1;
-        pending_colum_move_digits_step = 10;
+    int softwrap_prev = sw_no, softwrap = sw_no;
 
-        uint32_t current_fg = -1;
-        uint32_t current_bg = -1;
-        uint32_t current_deco = -1;
-        uint32_t current_flags = -1;
-        uint32_t current_patch_idx = 0; // patch index is special because it could do anything.
-        bool cleared = false;
+    // After a partial flush continue with the rows that were not painted, unless that would start in the
+    // middle of soft wrapped rows.
+    int first_row = term->flush_resume_row;
+    if (first_row >= term->primary.height
+            || (first_row > 0 && termpaintp_flush_row_softwrap(term, first_row - 1) != sw_no)) {
+        first_row = 0;
+    }
+    term->flush_resume_row = 0;
 
-        softwrap = sw_no;
-        if (y+1 < term->primary.height && term->primary.width) {
-            cell* first_next_line = termpaintp_getcell(&term->primary, 0, y + 1);
-            if (first_next_line->flags & CELL_SOFTWRAP_MARKER
-                    && (first_next_line->text_len || first_next_line->text_overflow != nullptr)) {
+    for (int row = 0; row < term->primary.height; row++) {
+        const int y = (first_row + row) % term->primary.height;
 
-                cell* last_this_line = termpaintp_getcell(&term->primary, term->primary.width - 1, y);
-                if (last_this_line->flags & CELL_SOFTWRAP_MARKER
-                        && (last_this_line->text_len || last_this_line->text_overflow != nullptr)) {
-                    softwrap = sw_single;
-                } else if (last_this_line->text_len == 0
-                           && last_this_line->text_overflow == nullptr
-                           && term->primary.width >= 2) {
-                    last_this_line = termpaintp_getcell(&term->primary, term->primary.width - 2, y);
-                    if (last_this_line->flags & CELL_SOFTWRAP_MARKER
-                            && (last_this_line->text_len || last_this_line->text_overflow != nullptr)
-                            && first_next_line->cluster_expansion == 1) {
-                        softwrap = sw_double;
-                    }
+        if (term->flush_budget && row > 0 && softwrap_prev == sw_no
+                && integration->p->bytes_written - bytes_written_start >= (size_t)term->flush_budget) {
+            bool pending = !skip_identical;
+            for (int i = row; !pending && i < term->primary.height; i++) {
+                const termpaintp_row_damage *damage = &term->primary.row_damage[(first_row + i) % term->primary.height];
+                pending = damage->x0 <= damage->x1;
+            }
+            if (!pending) {
+                // The remaining rows are unchanged, walking them would only repeat their trailing erase.
+                break;
+            }
+            // Budget exhausted, the remaining rows keep their damage and are painted by the next flush.
+            term->last_flush_partial = true;
+            term->flush_resume_row = y;
+            if (!skip_identical) {
+                // the terminal contents of the remaining rows can not be relied upon
+                for (int i = row; i < term->primary.height; i++) {
+                    termpaintp_terminal_forget_row(term, (first_row + i) % term->primary.height);
                 }
             }
+            break;
         }
 
+        cursor.reprint_x = 0;
+        cursor.reprint_bytes = 0;
+
+        uint32_t current_attr = ATTR_ID_NONE; // quantized attributes including patch, ATTR_ID_NONE if not known
+        // attributes used by the terminal, colors and flags stay valid when a patch is cleaned up.
+        termpaintp_attr_entry current = termpaintp_attr_make(-1, -1, -1, -1, 0);
+        uint32_t current_patch_idx = 0; // patch index is special because it could do anything.
+        bool sgr_state_exact = false; // true if the terminal is known to use exactly the current_* attributes
+        bool cleared = false;
+
+        softwrap = termpaintp_flush_row_softwrap(term, y);
+
         int first_noncopy_space = term->primary.width;
-        if (termpaint_terminal_capable(term, TERMPAINT_CAPABILITY_CLEARED_COLORING)) {
+        if (cleared_coloring) {
             if (softwrap == sw_no) {
                 for (int x = term->primary.width - 1; x >= 0; x--) {
                     cell* c = termpaintp_getcell(&term->primary, x, y);
+                    const termpaintp_attr_entry *attr = termpaintp_cell_attr(&term->primary, c);
                     if ((c->text_len == 0 && c->text_overflow == nullptr)
-                            && (c->flags & CELL_ATTR_INVERSE) == 0
-                            && (cleared_defcolor || c->bg_color != TERMPAINT_DEFAULT_COLOR)) {
+                            && (attr->flags & CELL_ATTR_INVERSE) == 0
+                            && (cleared_defcolor || attr->bg_color != TERMPAINT_DEFAULT_COLOR)) {
                         first_noncopy_space = x;
                     } else {
                         break;
@@ -2397,8 +4578,71 @@ void termpaint_terminal_flush(termpaint_terminal *term, bool full_repaint) {
             }
         }
 
-        for (int x = 0; x < term->primary.width; x++) {
+        // Only rows and parts of rows that might have changed since the last flush need to be considered.
+        // Rows involved in soft wrapping are always processed completely.
+        int x_begin = 0;
+        int x_end = term->primary.width;
+        termpaintp_row_damage *damage = &term->primary.row_damage[y];
+        if (!full_repaint && softwrap == sw_no && softwrap_prev == sw_no) {
+            if (damage->x1 < damage->x0) {
+                x_begin = term->primary.width;
+            } else {
+                x_begin = damage->x0;
+                while (x_begin > 0) {
+                    cell* c = termpaintp_getcell(&term->primary, x_begin, y);
+                    if (c->text_len == 0 && c->text_overflow == WIDE_RIGHT_PADDING) {
+                        --x_begin;
+                    } else {
+                        break;
+                    }
+                }
+                x_end = damage->x1 + 1;
+            }
+            if (first_noncopy_space < term->primary.width - 1) {
+                // cells after the start of the trailing erase area depend on what was painted before them
+                // in this row, so they are always processed.
+                if (first_noncopy_space + 1 < x_begin) {
+                    x_begin = first_noncopy_space + 1;
+                }
+                x_end = term->primary.width;
+            }
+            if (x_begin > 0) {
+                cursor.reprint_bytes = -1;
+            }
+        }
+        damage->x0 = term->primary.width;
+        damage->x1 = -1;
+
+        // unchanged cells after the start of the trailing erase area might still need painting
+        const int x_skip_end = first_noncopy_space + 1 < x_end ? first_noncopy_space + 1 : x_end;
+        for (int x = x_begin; x < term->primary.width; x++) {
+            if (skip_identical && softwrap == sw_no && softwrap_prev == sw_no && !cleared
+                    && cursor.reprint_bytes == -1 && current_patch_idx == 0 && x < x_skip_end) {
+                // Fast path, in this state skipping an unchanged cell does not change any state.
+                const int row_start = y * term->primary.width;
+                int x_next = x + termpaintp_count_identical_cells(&term->primary.cells[row_start + x],
+                                                                  &term->primary.cells_last_flush[row_start + x],
+                                                                  x_skip_end - x);
+                // the first differing cell might be in the middle of an unchanged cluster
+                while (x_next > x && x_next < term->primary.width) {
+                    cell* c = termpaintp_getcell(&term->primary, x_next, y);
+                    if (c->text_len == 0 && c->text_overflow == WIDE_RIGHT_PADDING) {
+                        --x_next;
+                    } else {
+                        break;
+                    }
+                }
+                x = x_next;
+                if (x >= term->primary.width) {
+                    break;
+                }
+            }
+            if (x >= x_end && !cleared) {
+                // rest of row is unchanged
+                break;
+            }
             cell* c = termpaintp_getcell(&term->primary, x, y);
+            const int cell_x = x;
             cell* old_c = &term->primary.cells_last_flush[y*term->primary.width+x];
             int code_units;
             bool text_changed;
@@ -2420,23 +4664,20 @@ void termpaint_terminal_flush(termpaint_terminal *term, bool full_repaint) {
                 }
             }
 
-            uint32_t effective_fg_color = termpaintp_quantize_color(term, c->fg_color);
-            uint32_t effective_bg_color = termpaintp_quantize_color(term, c->bg_color);
-
-            bool needs_paint = full_repaint || effective_bg_color != old_c->bg_color || effective_fg_color != old_c->fg_color
-                    || c->flags != old_c->flags || c->attr_patch_idx != old_c->attr_patch_idx || text_changed;
+            // In the last flush attributes were saved quantized, unless buffers were swapped.
+            const uint32_t quantized_id = termpaintp_terminal_quantized_attr(term, c->attr_id);
+            const uint32_t old_quantized_id = old_colors_raw ? termpaintp_terminal_quantized_attr(term, old_c->attr_id)
+                                                             : old_c->attr_id;
+            // copy, interning later in this loop might move the table
+            const termpaintp_attr_entry attr = term->primary.attrs.entries[quantized_id];
 
-            uint32_t effective_deco_color;
-            if (c->flags & CELL_ATTR_DECO_MASK) {
-                effective_deco_color = c->deco_color;
-                needs_paint |= effective_deco_color != old_c->deco_color;
-            } else {
-                effective_deco_color = TERMPAINT_DEFAULT_COLOR;
-            }
+            bool needs_paint = full_repaint || quantized_id != old_quantized_id || c->flags != old_c->flags
+                    || text_changed;
 
-            bool needs_attribute_change = effective_bg_color != current_bg || effective_fg_color != current_fg
-                    || effective_deco_color != current_deco || (c->flags & CELL_ATTR_MASK) != current_flags
-                    || c->attr_patch_idx != current_patch_idx;
+            bool needs_attribute_change = quantized_id != current_attr
+                    && (attr.bg_color != current.bg_color || attr.fg_color != current.fg_color
+                        || attr.deco_color != current.deco_color || attr.flags != current.flags
+                        || attr.patch_idx != current_patch_idx);
 
             if (first_noncopy_space < x) {
                 needs_paint = needs_attribute_change || (needs_paint && !cleared);
@@ -2465,156 +4706,105 @@ void termpaint_terminal_flush(termpaint_terminal *term, bool full_repaint) {
                 needs_paint = true;
             }
 
-            *old_c = *c;
-            old_c->bg_color = effective_bg_color;
-            old_c->fg_color = effective_fg_color;
-            for (int i = 0; i < c->cluster_expansion; i++) {
-                cell* wipe_c = &term->primary.cells_last_flush[y*term->primary.width+x+i+1];
-                wipe_c->text_len = 1;
-                wipe_c->text[0] = '\x01'; // impossible value, filtered out earlier in output pipeline
+            if (!swap_buffers) {
+                *old_c = *c;
+                old_c->attr_id = quantized_id;
+                for (int i = 0; i < c->cluster_expansion; i++) {
+                    cell* wipe_c = &term->primary.cells_last_flush[y*term->primary.width+x+i+1];
+                    wipe_c->text_len = 1;
+                    wipe_c->text[0] = '\x01'; // impossible value, filtered out earlier in output pipeline
+                }
             }
 
             if (!needs_paint) {
                 if (current_patch_idx) {
-                    int_uputs(integration, term->primary.patches[current_patch_idx-1].cleanup);
+                    int_uputs(integration, term->primary.patches.entries[current_patch_idx-1].cleanup);
                     current_patch_idx = 0;
+                    current_attr = ATTR_ID_NONE;
+                    sgr_state_exact = false;
+                    cursor.reprint_bytes = -1;
                 }
 
-                pending_colum_move += 1 + c->cluster_expansion;
-                if (speculation_buffer_state != -1) {
+                if (cursor.reprint_bytes != -1) {
                     if (needs_attribute_change) {
-                        // needs_attribute_change needs >= 24 chars, so repositioning will likely be cheaper (and easier to implement)
-                        speculation_buffer_state = -1;
+                        cursor.reprint_bytes = -1;
                     } else {
-                        if (pending_colum_move >= pending_colum_move_digits_step) {
-                            pending_colum_move_digits += 1;
-                            pending_colum_move_digits_step *= 10;
-                        }
-
-                        if (pending_colum_move_digits + 3 < speculation_buffer_state + code_units) {
-                            // the move sequence is shorter than moving by printing chars
-                            speculation_buffer_state = -1;
-                        } else if (speculation_buffer_state + code_units < (int)sizeof (speculation_buffer)) {
-                            memcpy(speculation_buffer + speculation_buffer_state, (char*)text, code_units);
-                        } else {
-                            // speculation buffer to small
-                            speculation_buffer_state = -1;
+                        cursor.reprint_bytes += code_units;
+                        if (cursor.reprint_bytes > max_move_cost) {
+                            cursor.reprint_bytes = -1;
                         }
                     }
                 }
                 x += c->cluster_expansion;
                 continue;
-            } else {
-                if (pending_row_move) {
-                    int_puts(integration, "\r");
-                    if (pending_row_move < 4) {
-                        while (pending_row_move) {
-                            int_puts(integration, "\n");
-                            --pending_row_move;
-                        }
-                    } else {
-                        int_puts(integration, "\033[");
-                        int_put_num(integration, pending_row_move);
-                        int_puts(integration, "B");
-                        pending_row_move = 0;
-                    }
-                }
-                if (pending_colum_move) {
-                    if (speculation_buffer_state > 0) {
-                        int_write(integration, speculation_buffer, speculation_buffer_state);
-                    } else {
-                        int_puts(integration, "\033[");
-                        if (pending_colum_move != 1) {
-                            int_put_num(integration, pending_colum_move);
-                        }
-                        int_puts(integration, "C");
-                    }
-                    speculation_buffer_state = 0;
-                    pending_colum_move = 0;
-                    pending_colum_move_digits = 1;
-                    pending_colum_move_digits_step = 10;
-                }
+            } else if (softwrap_prev == sw_no) {
+                // after a soft wrapped row the cursor wraps to the start of this row by printing
+                termpaintp_flush_move_cursor(term, &cursor, cell_x, y);
             }
 
             if (needs_attribute_change) {
-                int_puts(integration, "\033[0");
-                termpaintp_sgr_params params;
-                params.index = 1;
-                params.max = term->max_csi_parameters;
-#define PUT_PARAMETER(s)                             \
-    do { if (params.index + 1 >= params.max) {       \
-        int_puts(integration, "m\033[");             \
-        int_puts(integration, ((const char*)s) + 1); \
-        params.index = 1;                            \
-    } else {                                         \
-        int_puts(integration, s);                    \
-        params.index += 1;                           \
-    } } while (false)                                \
-    /* end macro */
-                write_color_sgr_values(integration, &params, effective_bg_color, ";48;2;", ";48;5;", ";", 40, 100);
-                write_color_sgr_values(integration, &params, effective_fg_color, ";38;2;", ";38;5;", ";", 30, 90);
-                write_color_sgr_values(integration, &params, effective_deco_color, ";58:2:", ";58:5:", ":", 0, 0);
-                if (c->flags) {
-                    if (c->flags & CELL_ATTR_BOLD) {
-                        PUT_PARAMETER(";1");
-                    }
-                    if (c->flags & CELL_ATTR_ITALIC) {
-                        PUT_PARAMETER(";3");
-                    }
-                    uint32_t underline = c->flags & CELL_ATTR_UNDERLINE_MASK;
-                    if (underline == CELL_ATTR_UNDERLINE_SINGLE) {
-                        PUT_PARAMETER(";4");
-                    } else if (underline == CELL_ATTR_UNDERLINE_DOUBLE) {
-                        PUT_PARAMETER(";21");
-                    } else if (underline == CELL_ATTR_UNDERLINE_CURLY) {
-                        // TODO maybe filter this by terminal capability somewhere?
-                        if (params.index + 2 >= params.max) {
-                            int_puts(integration, "m\033[");
-                            int_puts(integration, "4:3");
-                            params.index = 2;
-                        } else {
-                            int_puts(integration, ";4:3");
-                            params.index += 2;
-                        }
-                    }
-                    if (c->flags & CELL_ATTR_BLINK) {
-                        PUT_PARAMETER(";5");
-                    }
-                    if (c->flags & CELL_ATTR_OVERLINE) {
-                        PUT_PARAMETER(";53");
-                    }
-                    if (c->flags & CELL_ATTR_INVERSE) {
-                        PUT_PARAMETER(";7");
-                    }
-                    if (c->flags & CELL_ATTR_STRIKE) {
-                        PUT_PARAMETER(";9");
-                    }
+                const termpaintp_sgr_cache_entry *sgr = termpaintp_terminal_sgr_lookup(term, attr.bg_color,
+                        attr.fg_color, attr.deco_color, attr.flags);
+                termpaintp_sgr_buffer delta;
+                bool use_delta = false;
+                if (term->sgr_delta_encoding && sgr_state_exact && attr.patch_idx == 0) {
+                    termpaintp_sgr_serialize_delta(&delta, term->max_csi_parameters,
+                                                   current.bg_color, current.fg_color, current.deco_color,
+                                                   current.flags,
+                                                   attr.bg_color, attr.fg_color, attr.deco_color, attr.flags);
+                    use_delta = delta.len < sgr->sgr.len;
                 }
-                int_puts(integration, "m");
-#undef PUT_PARAMETER
-                current_bg = effective_bg_color;
-                current_fg = effective_fg_color;
-                current_deco = effective_deco_color;
-                current_flags = c->flags & CELL_ATTR_MASK;
+                if (use_delta) {
+                    int_write(integration, delta.data, delta.len);
+                } else {
+                    int_write(integration, sgr->sgr.data, sgr->sgr.len);
+                }
+                // patches could change anything, so only assume a known state without any patches involved.
+                sgr_state_exact = current_patch_idx == 0 && attr.patch_idx == 0;
+                current_attr = quantized_id;
+                current = attr;
 
-                if (current_patch_idx != c->attr_patch_idx) {
+                if (current_patch_idx != attr.patch_idx) {
                     if (current_patch_idx) {
-                        int_uputs(integration, term->primary.patches[current_patch_idx-1].cleanup);
+                        int_uputs(integration, term->primary.patches.entries[current_patch_idx-1].cleanup);
                     }
-                    if (c->attr_patch_idx) {
-                        int_uputs(integration, term->primary.patches[c->attr_patch_idx-1].setup);
+                    if (attr.patch_idx) {
+                        int_uputs(integration, term->primary.patches.entries[attr.patch_idx-1].setup);
                     }
                 }
 
-                current_patch_idx = c->attr_patch_idx;
+                current_patch_idx = attr.patch_idx;
             }
-            if (first_noncopy_space <= x) {
+            int repeat = 0;
+            if (repeat_char && first_noncopy_space > x && softwrap == sw_no && softwrap_prev == sw_no
+                    && current_patch_idx == 0 && c->cluster_expansion == 0
+                    && termpaintp_utf8_len(text[0]) == code_units) {
+                repeat = termpaintp_terminal_count_repeatable(term, x, y,
+                                                               first_noncopy_space < x_end ? first_noncopy_space : x_end);
+            }
+            if (repeat && cleared_coloring && c->text_len == 0 && c->text_overflow == nullptr
+                    && (attr.flags & CELL_ATTR_INVERSE) == 0
+                    && (cleared_defcolor || attr.bg_color != TERMPAINT_DEFAULT_COLOR)
+                    && 2 * (3 + termpaintp_num_digits(repeat + 1)) < repeat + 1) {
+                // erase the run of spaces and move past it, the move might be merged with later moves
+                int_puts(integration, "\033[");
+                int_put_num(integration, repeat + 1);
+                int_puts(integration, "X");
+                cursor.reprint_bytes = -1;
+            } else if (first_noncopy_space <= x) {
                 int_write(integration, "\033[K", 3);
-                pending_colum_move++;
-                speculation_buffer_state = -1;
+                cursor.reprint_bytes = -1;
                 cleared = true;
             } else {
                 int_write(integration, (char*)text, code_units);
+                if (repeat && 3 + termpaintp_num_digits(repeat) < repeat * code_units) {
+                    int_puts(integration, "\033[");
+                    int_put_num(integration, repeat);
+                    int_puts(integration, "b");
+                } else {
+                    repeat = 0;
+                }
+                termpaintp_flush_cursor_printed(term, &cursor, cell_x, y, 1 + c->cluster_expansion + repeat);
                 if (softwrap_prev != sw_no) {
                     softwrap_prev = sw_no;
                     if (term->did_terminal_disable_wrap) {
@@ -2628,55 +4818,42 @@ void termpaint_terminal_flush(termpaint_terminal *term, bool full_repaint) {
                 }
             }
             if (current_patch_idx) {
-                if (!term->primary.patches[c->attr_patch_idx-1].optimize) {
-                    int_uputs(integration, term->primary.patches[c->attr_patch_idx-1].cleanup);
+                if (!term->primary.patches.entries[attr.patch_idx-1].optimize) {
+                    int_uputs(integration, term->primary.patches.entries[attr.patch_idx-1].cleanup);
                     current_patch_idx = 0;
+                    current_attr = ATTR_ID_NONE;
+                    sgr_state_exact = false;
                 }
             }
-            x += c->cluster_expansion;
+            for (int i = 0; !swap_buffers && i < repeat; i++) {
+                cell* repeat_old_c = &term->primary.cells_last_flush[y*term->primary.width+x+i+1];
+                *repeat_old_c = *termpaintp_getcell(&term->primary, x+i+1, y);
+                repeat_old_c->attr_id = quantized_id;
+            }
+            x += c->cluster_expansion + repeat;
         }
 
         if (current_patch_idx) {
-            int_uputs(integration, term->primary.patches[current_patch_idx-1].cleanup);
+            int_uputs(integration, term->primary.patches.entries[current_patch_idx-1].cleanup);
             current_patch_idx = 0;
         }
 
-        if (softwrap == sw_no) {
-            if (full_repaint) {
-                if (y+1 < term->primary.height) {
-                    int_puts(integration, "\r\n");
-                }
-            } else {
-                pending_row_move += 1;
-            }
-        }
-
         softwrap_prev = softwrap;
     }
-    if (pending_row_move > 1) {
-        --pending_row_move; // don't move after paint rect
-        int_puts(integration, "\r");
-        if (pending_row_move < 4) {
-            while (pending_row_move) {
-                int_puts(integration, "\n");
-                --pending_row_move;
-            }
-        } else {
-            int_puts(integration, "\033[");
-            int_put_num(integration, pending_row_move);
-            int_puts(integration, "B");
-        }
+
+    if (swap_buffers) {
+        termpaintp_terminal_swap_buffers(term, scrolled);
     }
 
     if (term->cursor_x != -1 && term->cursor_y != -1) {
         termpaintp_terminal_set_cursor(term, term->cursor_x, term->cursor_y);
-    } else {
-        if (pending_colum_move) {
-            int_puts(integration, "\033[");
-            if (pending_colum_move != 1) {
-                int_put_num(integration, pending_colum_move);
-            }
-            int_puts(integration, "C");
+    } else if (term->primary.width && term->primary.height) {
+        // leave the cursor at the end of the last row
+        const int last_x = term->primary.width - 1;
+        const int last_y = term->primary.height - 1;
+        if (!cursor.known || cursor.x != last_x || cursor.y != last_y) {
+            cursor.reprint_bytes = -1;
+            termpaintp_flush_move_cursor(term, &cursor, last_x, last_y);
         }
     }
 
@@ -2705,6 +4882,9 @@ void termpaint_terminal_flush(termpaint_terminal *term, bool full_repaint) {
         }
     }
     int_puts(integration, "\033[m");
+    if (synchronized_update) {
+        int_puts(integration, "\033[?2026l");
+    }
     int_flush(integration);
 }
 
@@ -3172,6 +5352,7 @@ static void termpaintp_auto_detect_init_terminal_version_and_caps(termpaint_term
         termpaint_terminal_promise_capability(term, TERMPAINT_CAPABILITY_MAY_TRY_TAGGED_PASTE);
         termpaint_terminal_promise_capability(term, TERMPAINT_CAPABILITY_TRUECOLOR_SUPPORTED);
         term->max_csi_parameters = 10;
+        memset(term->sgr_cache, 0, sizeof(term->sgr_cache));
     } else if (term->terminal_type == TT_MSFT_TERMINAL) {
         termpaint_terminal_promise_capability(term, TERMPAINT_CAPABILITY_TRUECOLOR_SUPPORTED);
     } else if (term->terminal_type == TT_FULL) {
@@ -3185,6 +5366,18 @@ static void termpaintp_auto_detect_init_terminal_version_and_caps(termpaint_term
         termpaint_terminal_promise_capability(term, TERMPAINT_CAPABILITY_TITLE_RESTORE);
         termpaint_terminal_promise_capability(term, TERMPAINT_CAPABILITY_TRUECOLOR_SUPPORTED);
     }
+
+    if (term->terminal_type > TT_BASE) {
+        // Scroll regions (DECSTBM) are from the VT100 and IL/DL from the VT102. Every specifically identified
+        // terminal implements them, this includes screen and tmux, the linux console and the macOS Terminal.
+        termpaint_terminal_promise_capability(term, TERMPAINT_CAPABILITY_SCROLL_REGION);
+    }
+
+    if (term->terminal_type == TT_XTERM || term->terminal_type == TT_KITTY || term->terminal_type == TT_MINTTY
+            || term->terminal_type == TT_MSFT_TERMINAL || term->terminal_type == TT_FULL
+            || (term->terminal_type == TT_VTE && term->terminal_version >= 5200)) { // vte supports REP since 0.52
+        termpaint_terminal_promise_capability(term, TERMPAINT_CAPABILITY_REPEAT_CHAR);
+    }
 }
 
 void termpaint_terminal_auto_detect_apply_input_quirks(termpaint_terminal *terminal, bool backspace_is_x08) {
@@ -3364,6 +5557,8 @@ static void termpaintp_terminal_auto_detect_prepare_self_reporting(termpaint_ter
     termpaint_integration *integration = terminal->integration;
 
     int_puts(integration, "\033[>q");
+    // DECRQM for synchronized updates, terminals that know this mode report it as set or reset
+    int_puts(integration, "\033[?2026$p");
     bool might_be_kitty = false;
     bool might_be_iterm2 = false;
     bool might_be_mlterm = false;
@@ -3817,6 +6012,14 @@ static bool termpaintp_terminal_auto_detect_event(termpaint_terminal *terminal,
                     }
                 }
                 return true;
+            } else if (event->type == TERMPAINT_EV_MODE_REPORT) {
+                terminal->ad_state = AD_SELF_REPORTING;
+                // status 0 is an unknown mode, 3 and 4 are permanently set or reset modes
+                if (event->mode.kind == 1 && event->mode.number == 2026
+                        && (event->mode.status == 1 || event->mode.status == 2)) {
+                    termpaint_terminal_promise_capability(terminal, TERMPAINT_CAPABILITY_SYNCHRONIZED_UPDATE);
+                }
+                return true;
             }
             break;
         case AD_WAIT_FOR_SYNC_TO_FINISH:
@@ -4330,6 +6533,7 @@ termpaint_attr *termpaint_attr_clone_or_nullptr(const termpaint_attr *orig) {
     attr->deco_color = orig->deco_color;
 
     attr->flags = orig->flags;
+    attr->patch_serial = orig->patch_serial;
 
     if (orig->patch_setup) {
         attr->patch_setup = ustrdup(orig->patch_setup);
@@ -4401,13 +6605,18 @@ void termpaint_attr_reset_style(termpaint_attr *attr) {
 }
 
 bool termpaint_attr_set_patch_mustcheck(termpaint_attr *attr, bool optimize, const char *setup, const char *cleanup) {
+    // shared by all threads, so that cached patch indices in surfaces are never confused between attributes.
+    static atomic_uint_fast64_t last_patch_serial;
+
     free(attr->patch_setup);
     attr->patch_setup = nullptr;
     free(attr->patch_cleanup);
     attr->patch_cleanup = nullptr;
+    attr->patch_serial = 0;
     if (!setup || !cleanup) {
         attr->patch_optimize = false;
     } else {
+        attr->patch_serial = atomic_fetch_add(&last_patch_serial, 1) + 1;
         attr->patch_optimize = optimize;
         attr->patch_setup = (uchar*)strdup(setup);
         if (!attr->patch_setup) {
@@ -5169,10 +7378,83 @@ static bool termpaintp_test_parse_version(void) {
 }
 
 // this in internal don't link to this externally
+static bool termpaintp_test_quantize_cache(void) {
+    termpaint_terminal terminal;
+    memset(&terminal, 0, sizeof(terminal));
+    for (int mode = 0; mode < 2; mode++) {
+        terminal.capabilities[TERMPAINT_CAPABILITY_88_COLOR] = mode == 1;
+        memset(terminal.quantize_cache, 0, sizeof(terminal.quantize_cache));
+        for (int i = 0; i < 2; i++) {
+            for (int r = 0; r < 256; r += 15) {
+                for (int g = 0; g < 256; g += 17) {
+                    for (int b = 0; b < 256; b += 13) {
+                        const uint32_t color = TERMPAINT_RGB_COLOR(r, g, b);
+                        if (termpaintp_quantize_color_cached(&terminal, color)
+                                != termpaintp_quantize_color(&terminal, color)) {
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return termpaintp_quantize_color_cached(&terminal, TERMPAINT_INDEXED_COLOR + 3) == TERMPAINT_INDEXED_COLOR + 3;
+}
+
+static bool termpaintp_test_sgr_cache(void) {
+    termpaint_terminal terminal;
+    memset(&terminal, 0, sizeof(terminal));
+    terminal.max_csi_parameters = 15;
+
+    const termpaintp_sgr_cache_entry *entry;
+    entry = termpaintp_terminal_sgr_lookup(&terminal, TERMPAINT_RGB_COLOR(1, 2, 3), TERMPAINT_INDEXED_COLOR + 17,
+                                           TERMPAINT_DEFAULT_COLOR, CELL_ATTR_BOLD);
+    const char *expected = "\033[0;48;2;1;2;3;38;5;17;1m";
+    if (entry->sgr.len != (int)strlen(expected) || memcmp(entry->sgr.data, expected, entry->sgr.len) != 0) {
+        return false;
+    }
+
+    // more entries than the cache can hold, looked up twice to exercise eviction
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < SGR_CACHE_SETS * SGR_CACHE_WAYS * 2; i++) {
+            const uint32_t color = TERMPAINT_RGB_COLOR(i, 255 - i, 0);
+            entry = termpaintp_terminal_sgr_lookup(&terminal, color, color, color, CELL_ATTR_MASK);
+            termpaintp_sgr_buffer reference;
+            termpaintp_sgr_serialize(&reference, terminal.max_csi_parameters, color, color, color, CELL_ATTR_MASK);
+            if (entry->sgr.len != reference.len || memcmp(entry->sgr.data, reference.data, reference.len) != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool termpaintp_test_sgr_delta(void) {
+    termpaintp_sgr_buffer out;
+    termpaintp_sgr_serialize_delta(&out, 15,
+                                   TERMPAINT_DEFAULT_COLOR, TERMPAINT_NAMED_COLOR + 1, TERMPAINT_DEFAULT_COLOR,
+                                   CELL_ATTR_BOLD | CELL_ATTR_UNDERLINE_SINGLE,
+                                   TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR,
+                                   CELL_ATTR_UNDERLINE_DOUBLE | CELL_ATTR_INVERSE);
+    const char *expected = "\033[39;22;21;7m";
+    if (out.len != (int)strlen(expected) || memcmp(out.data, expected, out.len) != 0) {
+        return false;
+    }
+    termpaintp_sgr_serialize_delta(&out, 15,
+                                   TERMPAINT_INDEXED_COLOR + 3, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR,
+                                   CELL_ATTR_BLINK,
+                                   TERMPAINT_INDEXED_COLOR + 3, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR,
+                                   CELL_ATTR_BLINK);
+    return out.len == 0;
+}
+
 _tERMPAINT_PUBLIC bool termpaintp_test(void) {
     bool ret = true;
     ret &= termpaintp_test_quantize_to_256();
     ret &= termpaintp_test_quantize_to_88();
+    ret &= termpaintp_test_quantize_cache();
+    ret &= termpaintp_test_sgr_cache();
+    ret &= termpaintp_test_sgr_delta();
     ret &= termpaintp_test_parse_version();
     ret &= termpaintp_mem_ascii_case_insensitive_equals("A", "a", 1);
     ret &= !termpaintp_mem_ascii_case_insensitive_equals("[", "{", 1);
@@ -63,6 +63,10 @@ _tERMPAINT_PUBLIC void termpaint_terminal_free(termpaint_terminal *term);
 _tERMPAINT_PUBLIC void termpaint_terminal_free_with_restore(termpaint_terminal *term);
 _tERMPAINT_PUBLIC termpaint_surface *termpaint_terminal_get_surface(termpaint_terminal *term);
 _tERMPAINT_PUBLIC void termpaint_terminal_flush(termpaint_terminal *term, _Bool full_repaint);
+_tERMPAINT_PUBLIC void termpaint_terminal_set_sgr_delta_encoding(termpaint_terminal *terminal, _Bool enabled);
+_tERMPAINT_PUBLIC void termpaint_terminal_set_swap_buffers(termpaint_terminal *terminal, _Bool enabled);
+_tERMPAINT_PUBLIC void termpaint_terminal_set_flush_budget(termpaint_terminal *terminal, int bytes);
+_tERMPAINT_PUBLIC _Bool termpaint_terminal_last_flush_partial(const termpaint_terminal *terminal);
 _tERMPAINT_PUBLIC const char *termpaint_terminal_restore_sequence(const termpaint_terminal *term);
 _tERMPAINT_PUBLIC void termpaint_terminal_set_cursor_position(termpaint_terminal *term, int x, int y);
 _tERMPAINT_PUBLIC void termpaint_terminal_set_cursor_visible(termpaint_terminal *term, _Bool visible);
@@ -146,6 +150,9 @@ _tERMPAINT_PUBLIC void termpaint_terminal_setup_fullscreen(termpaint_terminal *t
 #define TERMPAINT_CAPABILITY_MAY_TRY_CURSOR_SHAPE 13
 #define TERMPAINT_CAPABILITY_MAY_TRY_TAGGED_PASTE 14
 #define TERMPAINT_CAPABILITY_CLEARED_COLORING_DEFCOLOR 15
+#define TERMPAINT_CAPABILITY_SCROLL_REGION 16
+#define TERMPAINT_CAPABILITY_REPEAT_CHAR 17
+#define TERMPAINT_CAPABILITY_SYNCHRONIZED_UPDATE 18
 
 _tERMPAINT_PUBLIC _Bool termpaint_terminal_capable(const termpaint_terminal *terminal, int capability);
 _tERMPAINT_PUBLIC void termpaint_terminal_promise_capability(termpaint_terminal *terminal, int capability);
@@ -211,10 +218,27 @@ _tERMPAINT_PUBLIC void termpaint_attr_reset_style(termpaint_attr* attr);
 
 #define TERMPAINT_ERASED "\x7f"
 
+typedef struct termpaint_write_span_ {
+    int x;
+    int y;
+    const char *text;
+    int len;
+    const termpaint_attr *attr;
+} termpaint_write_span;
+
+typedef struct termpaint_rect_ {
+    int x;
+    int y;
+    int width;
+    int height;
+} termpaint_rect;
+
 _tERMPAINT_PUBLIC termpaint_surface *termpaint_terminal_new_surface(termpaint_terminal *term, int width, int height);
 _tERMPAINT_PUBLIC termpaint_surface *termpaint_terminal_new_surface_or_nullptr(termpaint_terminal *term, int width, int height);
 _tERMPAINT_PUBLIC termpaint_surface *termpaint_surface_new_surface(termpaint_surface *surface, int width, int height);
 _tERMPAINT_PUBLIC termpaint_surface *termpaint_surface_new_surface_or_nullptr(termpaint_surface *surface, int width, int height);
+_tERMPAINT_PUBLIC termpaint_surface *termpaint_surface_new_view(termpaint_surface *surface, int x, int y, int width, int height);
+_tERMPAINT_PUBLIC termpaint_surface *termpaint_surface_new_view_or_nullptr(termpaint_surface *surface, int x, int y, int width, int height);
 _tERMPAINT_PUBLIC termpaint_surface *termpaint_surface_duplicate(termpaint_surface *surface);
 _tERMPAINT_PUBLIC void termpaint_surface_free(termpaint_surface *surface);
 _tERMPAINT_PUBLIC void termpaint_surface_resize(termpaint_surface *surface, int width, int height);
@@ -230,6 +254,7 @@ _tERMPAINT_PUBLIC void termpaint_surface_write_with_attr(termpaint_surface *surf
 _tERMPAINT_PUBLIC void termpaint_surface_write_with_len_attr(termpaint_surface *surface, int x, int y, const char *string, int len, const termpaint_attr *attr);
 _tERMPAINT_PUBLIC void termpaint_surface_write_with_attr_clipped(termpaint_surface *surface, int x, int y, const char *string, const termpaint_attr *attr, int clip_x0, int clip_x1);
 _tERMPAINT_PUBLIC void termpaint_surface_write_with_len_attr_clipped(termpaint_surface *surface, int x, int y, const char *string, int len, const termpaint_attr *attr, int clip_x0, int clip_x1);
+_tERMPAINT_PUBLIC void termpaint_surface_write_spans(termpaint_surface *surface, const termpaint_write_span *spans, int count);
 _tERMPAINT_PUBLIC void termpaint_surface_clear(termpaint_surface *surface, int fg, int bg);
 _tERMPAINT_PUBLIC void termpaint_surface_clear_with_char(termpaint_surface *surface, int fg, int bg, int codepoint);
 _tERMPAINT_PUBLIC void termpaint_surface_clear_with_attr(termpaint_surface *surface, const termpaint_attr *attr);
@@ -262,6 +287,10 @@ _tERMPAINT_PUBLIC void termpaint_surface_peek_patch(const termpaint_surface *sur
 _tERMPAINT_PUBLIC const char *termpaint_surface_peek_text(const termpaint_surface *surface, int x, int y, int *len, int *left, int *right);
 _tERMPAINT_PUBLIC _Bool termpaint_surface_peek_softwrap_marker(const termpaint_surface *surface, int x, int y);
 _tERMPAINT_PUBLIC _Bool termpaint_surface_same_contents(const termpaint_surface *surface1, const termpaint_surface *surface2);
+_tERMPAINT_PUBLIC _Bool termpaint_surface_find_difference(const termpaint_surface *surface1, const termpaint_surface *surface2, int *x, int *y);
+_tERMPAINT_PUBLIC void termpaint_surface_damage_begin(termpaint_surface *surface);
+_tERMPAINT_PUBLIC int termpaint_surface_damage_collect(const termpaint_surface *surface, termpaint_rect *rects, int max_rects);
+_tERMPAINT_PUBLIC void termpaint_surface_damage_reset(termpaint_surface *surface);
 
 _tERMPAINT_PUBLIC termpaint_text_measurement* termpaint_text_measurement_new(const termpaint_surface *surface);
 _tERMPAINT_PUBLIC termpaint_text_measurement* termpaint_text_measurement_new_or_nullptr(const termpaint_surface *surface);
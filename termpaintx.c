@@ -34,6 +34,8 @@
 
 #define FDPTR(var) ((termpaint_integration_fd*)var)
 
+#define TERMPAINTP_DEFAULT_OUTPUT_BUFFER_SIZE 16384
+
 typedef struct termpaint_integration_fd_ {
     termpaint_integration base;
     char *options;
@@ -47,6 +49,21 @@ typedef struct termpaint_integration_fd_ {
     bool poll_sigwinch;
     termpaint_terminal *terminal;
     termpaintx_ttyrescue *rescue;
+    // output is collected here until the next flush or until it's full
+    char *output_buffer;
+    int output_buffer_size;
+    int output_buffer_used;
+    // statistics, current_* are since the last flush, last_flush_* are from the completed flush before that
+    int current_bytes;
+    int current_syscalls;
+    int last_flush_bytes;
+    int last_flush_syscalls;
+    // in non blocking mode output that could not be written yet is queued here
+    bool nonblocking_output;
+    char *pending_output;
+    int pending_output_start;
+    int pending_output_len;
+    int pending_output_capacity;
 } termpaint_integration_fd;
 
 static bool sigwinch_set;
@@ -202,8 +219,35 @@ termpaint_integration *termpaintx_full_integration_from_controlling_terminal(con
 }
 
 
+static void fd_flush(termpaint_integration* integration);
+static bool fd_write_pending(termpaint_integration* integration);
+
 static void fd_free(termpaint_integration* integration) {
     termpaint_integration_fd* fd_data = FDPTR(integration);
+    fd_flush(integration);
+
+    if (fd_data->pending_output_len) {
+        // Try to get queued output (likely including the restore sequence) to the terminal, but
+        // don't wait forever for a reader that might be gone.
+        struct timespec start_time;
+        clock_gettime(CLOCK_REALTIME, &start_time);
+        while (!fd_write_pending(integration) && fd_data->pending_output_len) {
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            long time_waited_ms = (now.tv_sec - start_time.tv_sec) * 1000
+                    + now.tv_nsec / 1000000 - start_time.tv_nsec / 1000000;
+            if (time_waited_ms >= 1000 || time_waited_ms < 0) {
+                break;
+            }
+            struct pollfd info;
+            info.fd = fd_data->fd_write;
+            info.events = POLLOUT;
+            if (poll(&info, 1, 1000 - time_waited_ms) < 0 && errno != EINTR) {
+                break;
+            }
+        }
+    }
+
     // If terminal auto detection or another operation with response is cut short
     // by a close the reponse will leak out into the next application.
     // We can't reliably prevent that here, but this kludge can reduce the likelyhood
@@ -245,54 +289,155 @@ static void fd_free(termpaint_integration* integration) {
         close(fd_data->fd_read);
     }
     free(fd_data->options);
+    free(fd_data->output_buffer);
+    free(fd_data->pending_output);
     termpaint_integration_deinit(&fd_data->base);
     free(fd_data);
 }
 
-static void fd_flush(termpaint_integration* integration) {
-    (void)integration;
-    // no buffering yet
-}
-
 static void fd_mark_bad(termpaint_integration* integration) {
     FDPTR(integration)->fd_read = -1;
     FDPTR(integration)->fd_write = -1;
+    // nothing can be written anymore
+    FDPTR(integration)->output_buffer_used = 0;
+    FDPTR(integration)->pending_output_start = 0;
+    FDPTR(integration)->pending_output_len = 0;
 }
 
 static _Bool fd_is_bad(termpaint_integration* integration) {
     return FDPTR(integration)->fd_read == -1;
 }
 
-static void fd_write_data(termpaint_integration* integration, const char *data, int length) {
+// returns the number of bytes written, this is only less than length if the integration is now bad
+// or in non blocking mode when the fd is not ready for writing.
+static int fd_write_some(termpaint_integration* integration, const char *data, int length) {
+    termpaint_integration_fd *t = FDPTR(integration);
     ssize_t written = 0;
     ssize_t ret;
     errno = 0;
     while (written != length) {
-        ret = write(FDPTR(integration)->fd_write, data+written, length-written);
+        ret = write(t->fd_write, data+written, length-written);
+        t->current_syscalls += 1;
         if (ret > 0) {
             written += ret;
+            t->current_bytes += (int)ret;
         } else {
             // error handling?
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // fatal, non blocking is not supported by this integration
+                if (t->nonblocking_output) {
+                    return (int)written;
+                }
+                // fatal, non blocking output was not enabled
                 fd_mark_bad(integration);
-                return;
+                return (int)written;
             }
             if (errno == EIO || errno == ENOSPC) {
                 // fatal?
                 fd_mark_bad(integration);
-                return;
+                return (int)written;
             }
             if (errno == EBADF || errno == EINVAL || errno == EPIPE) {
                 // fatal, or fd is gone bad
                 fd_mark_bad(integration);
-                return;
+                return (int)written;
             }
             if (errno == EINTR) {
                 continue;
             }
         }
     }
+    return (int)written;
+}
+
+static void fd_queue_pending(termpaint_integration* integration, const char *data, int length) {
+    termpaint_integration_fd *t = FDPTR(integration);
+    if (t->pending_output_start
+            && t->pending_output_start + t->pending_output_len + length > t->pending_output_capacity) {
+        memmove(t->pending_output, t->pending_output + t->pending_output_start, t->pending_output_len);
+        t->pending_output_start = 0;
+    }
+    if (t->pending_output_len + length > t->pending_output_capacity) {
+        int new_capacity = t->pending_output_capacity ? t->pending_output_capacity * 2 : 4096;
+        while (new_capacity < t->pending_output_len + length) {
+            new_capacity *= 2;
+        }
+        char *new_pending = realloc(t->pending_output, new_capacity);
+        if (!new_pending) {
+            // can't keep the output consistent anymore
+            fd_mark_bad(integration);
+            return;
+        }
+        t->pending_output = new_pending;
+        t->pending_output_capacity = new_capacity;
+    }
+    memcpy(t->pending_output + t->pending_output_start + t->pending_output_len, data, length);
+    t->pending_output_len += length;
+}
+
+// returns true if no output is pending anymore
+static bool fd_write_pending(termpaint_integration* integration) {
+    termpaint_integration_fd *t = FDPTR(integration);
+    if (!t->pending_output_len) {
+        return true;
+    }
+    int written = fd_write_some(integration, t->pending_output + t->pending_output_start, t->pending_output_len);
+    if (fd_is_bad(integration)) {
+        return false;
+    }
+    t->pending_output_start += written;
+    t->pending_output_len -= written;
+    if (!t->pending_output_len) {
+        t->pending_output_start = 0;
+        return true;
+    }
+    return false;
+}
+
+static void fd_write_unbuffered(termpaint_integration* integration, const char *data, int length) {
+    termpaint_integration_fd *t = FDPTR(integration);
+    if (t->pending_output_len && !fd_write_pending(integration)) {
+        // keep order of output
+        if (!fd_is_bad(integration)) {
+            fd_queue_pending(integration, data, length);
+        }
+        return;
+    }
+    int written = fd_write_some(integration, data, length);
+    if (written != length && !fd_is_bad(integration)) {
+        fd_queue_pending(integration, data + written, length - written);
+    }
+}
+
+static void fd_write_buffer(termpaint_integration* integration) {
+    termpaint_integration_fd *t = FDPTR(integration);
+    if (t->output_buffer_used) {
+        int used = t->output_buffer_used;
+        t->output_buffer_used = 0;
+        fd_write_unbuffered(integration, t->output_buffer, used);
+    }
+}
+
+static void fd_write_data(termpaint_integration* integration, const char *data, int length) {
+    termpaint_integration_fd *t = FDPTR(integration);
+    if (length > t->output_buffer_size - t->output_buffer_used) {
+        fd_write_buffer(integration);
+    }
+    if (length >= t->output_buffer_size) {
+        // does not fit into the buffer at all, avoid copying
+        fd_write_unbuffered(integration, data, length);
+        return;
+    }
+    memcpy(t->output_buffer + t->output_buffer_used, data, length);
+    t->output_buffer_used += length;
+}
+
+static void fd_flush(termpaint_integration* integration) {
+    termpaint_integration_fd *t = FDPTR(integration);
+    fd_write_buffer(integration);
+    t->last_flush_bytes = t->current_bytes;
+    t->last_flush_syscalls = t->current_syscalls;
+    t->current_bytes = 0;
+    t->current_syscalls = 0;
 }
 
 static void fd_request_callback(struct termpaint_integration_ *integration) {
@@ -374,6 +519,9 @@ static termpaint_integration *termpaintp_full_integration_from_fds(int fd_read,
     ret->auto_close = auto_close;
     ret->callback_requested = false;
     ret->awaiting_response = false;
+    ret->output_buffer = malloc(TERMPAINTP_DEFAULT_OUTPUT_BUFFER_SIZE);
+    ret->output_buffer_size = ret->output_buffer ? TERMPAINTP_DEFAULT_OUTPUT_BUFFER_SIZE : 0;
+    ret->output_buffer_used = 0;
 
     tcgetattr(ret->fd_read, &ret->original_terminal_attributes);
     termpaintp_fd_set_termios(ret->fd_read, options);
@@ -408,6 +556,7 @@ void termpaintx_full_integration_wait_for_ready_with_message(termpaint_integrati
             }
             if (milliseconds <= 0) {
                 fd_write_data(integration, message, strlen(message));
+                fd_flush(integration);
             }
         } else {
             if (!termpaintx_full_integration_do_iteration(integration)) {
@@ -418,6 +567,60 @@ void termpaintx_full_integration_wait_for_ready_with_message(termpaint_integrati
     }
 }
 
+bool termpaintx_full_integration_set_output_buffer_size(termpaint_integration *integration, int size) {
+    termpaint_integration_fd *t = FDPTR(integration);
+    if (size < 0) {
+        return false;
+    }
+    char *new_buffer = nullptr;
+    if (size) {
+        new_buffer = malloc(size);
+        if (!new_buffer) {
+            return false;
+        }
+    }
+    fd_write_buffer(integration);
+    free(t->output_buffer);
+    t->output_buffer = new_buffer;
+    t->output_buffer_size = size;
+    return true;
+}
+
+void termpaintx_full_integration_set_nonblocking_output(termpaint_integration *integration, bool enabled) {
+    termpaint_integration_fd *t = FDPTR(integration);
+    t->nonblocking_output = enabled;
+    if (!enabled && !fd_is_bad(integration)) {
+        // queued output is written with blocking writes, a write that would block is fatal otherwise.
+        int flags = fcntl(t->fd_write, F_GETFL);
+        if (flags != -1 && (flags & O_NONBLOCK)) {
+            fcntl(t->fd_write, F_SETFL, flags & ~O_NONBLOCK);
+        }
+        fd_write_pending(integration);
+    }
+}
+
+int termpaintx_full_integration_poll_write_fd(termpaint_integration *integration) {
+    termpaint_integration_fd *t = FDPTR(integration);
+    if (t->pending_output_len && !fd_is_bad(integration)) {
+        return t->fd_write;
+    }
+    return -1;
+}
+
+bool termpaintx_full_integration_resume_write(termpaint_integration *integration) {
+    return fd_write_pending(integration);
+}
+
+void termpaintx_full_integration_last_flush_statistics(termpaint_integration *integration, int *bytes, int *syscalls) {
+    termpaint_integration_fd *t = FDPTR(integration);
+    if (bytes) {
+        *bytes = t->last_flush_bytes;
+    }
+    if (syscalls) {
+        *syscalls = t->last_flush_syscalls;
+    }
+}
+
 bool termpaintx_full_integration_terminal_size(termpaint_integration *integration, int *width, int *height) {
     if (fd_is_bad(integration) || !isatty(FDPTR(integration)->fd_read)) {
         return false;
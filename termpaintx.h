@@ -28,6 +28,12 @@ _tERMPAINT_PUBLIC _Bool termpaintx_full_integration_terminal_size(termpaint_inte
 
 _tERMPAINT_PUBLIC _Bool termpaintx_full_integration_ttyrescue_start(termpaint_integration *integration);
 
+_tERMPAINT_PUBLIC _Bool termpaintx_full_integration_set_output_buffer_size(termpaint_integration *integration, int size);
+_tERMPAINT_PUBLIC void termpaintx_full_integration_last_flush_statistics(termpaint_integration *integration, int *bytes, int *syscalls);
+_tERMPAINT_PUBLIC void termpaintx_full_integration_set_nonblocking_output(termpaint_integration *integration, _Bool enabled);
+_tERMPAINT_PUBLIC int termpaintx_full_integration_poll_write_fd(termpaint_integration *integration);
+_tERMPAINT_PUBLIC _Bool termpaintx_full_integration_resume_write(termpaint_integration *integration);
+
 _tERMPAINT_PUBLIC const struct termios *termpaintx_full_integration_original_terminal_attributes(termpaint_integration *integration);
 
 _tERMPAINT_PUBLIC _Bool termpaintx_fd_set_termios(int fd, const char *options);
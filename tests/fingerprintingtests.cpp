@@ -20,7 +20,7 @@
 
 #define C(name) TERMPAINT_CAPABILITY_ ## name
 
-static const std::array<const char*, 11> allSeq = {
+static const std::array<const char*, 12> allSeq = {
         "\033[>c",
         "\033[>1c",
         "\033[>0;1c",
@@ -29,6 +29,7 @@ static const std::array<const char*, 11> allSeq = {
         "\033[6n",
         "\033[?6n",
         "\033[>q",
+        "\033[?2026$p",
         "\033[1x",
         "\033]4;255;?\007",
         "\033P+q544e\033\\",
@@ -40,6 +41,7 @@ static const std::vector<int> allCaps = {
     C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(TITLE_RESTORE), C(MAY_TRY_CURSOR_SHAPE_BAR), C(CURSOR_SHAPE_OSC50),
     C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED), C(88_COLOR),
     C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+    C(SCROLL_REGION), C(REPEAT_CHAR), C(SYNCHRONIZED_UPDATE),
 };
 
 static std::vector<int> allCapsBut(std::initializer_list<int> excluded) {
@@ -83,6 +85,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;128;128;1;0x" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\007" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -90,7 +93,9 @@ static const std::initializer_list<TestCase> tests = {
         "Type: xterm(264) safe-CPR seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(TITLE_RESTORE),
           C(EXTENDED_CHARSET),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION),
+          C(REPEAT_CHAR) },
         "",
         WithoutGlitchPatching
     },
@@ -106,6 +111,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS};1R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\007" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -113,7 +119,9 @@ static const std::initializer_list<TestCase> tests = {
         "Type: xterm(280) safe-CPR seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(TITLE_RESTORE),
           C(EXTENDED_CHARSET),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION),
+          C(REPEAT_CHAR) },
         "",
         WithoutGlitchPatching
     },
@@ -129,6 +137,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS};1R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\007" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -136,7 +145,9 @@ static const std::initializer_list<TestCase> tests = {
         "Type: xterm(336) safe-CPR seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(TITLE_RESTORE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION),
+          C(REPEAT_CHAR) },
         "",
         WithoutGlitchPatching
     },
@@ -152,6 +163,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS};1R" }},
             { "\033[>q",          { "\033P>|XTerm(354)\033\\" }},
+            { "\033[?2026$p",     { "\033[?2026;0$y" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\007" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -159,7 +171,9 @@ static const std::initializer_list<TestCase> tests = {
         "Type: xterm(354) safe-CPR seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(TITLE_RESTORE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION),
+          C(REPEAT_CHAR) },
         "XTerm(354)",
         WithoutGlitchPatching
     },
@@ -175,14 +189,38 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R", }},
             { "\033[?6n",         { "\033[?{POS}R", }},
             { "\033[>q",          { "", }},
+            { "\033[?2026$p",     { "", }},
             { "\033[1x",          { "", }},
             { "\033]4;255;?\007", { "", }},
             { "\033P+q544e\033\\",{ "" }},
         },
         "Type: unknown full featured(0) safe-CPR seq:>=",
-        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR)}), // should have all compliant capabilites.
+        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR), C(SYNCHRONIZED_UPDATE)}), // should have all compliant capabilites.
             // excluding CURSOR_SHAPE_OSC50 because it's konsole specific and non standard
             // excluding 88_COLOR because it reduces 256 color palette to 88 color.
+            // excluding SYNCHRONIZED_UPDATE because it's only set when the terminal reports knowing mode 2026.
+        "",
+        WithoutGlitchPatching
+    },
+    // ---------------
+    {
+        "DA3 new id promise (safe-CPR) with synchronized update mode" LINEINFO,
+        {
+            { "\033[>c",          { "\033[>61;234;0c" }},
+            { "\033[>1c",         { "" }},
+            { "\033[>0;1c",       { "\033[>61;234;0c", }},
+            { "\033[=c",          { "\033P!|FEFEFEFE\033\\", }},
+            { "\033[5n",          { "\033[0n", }},
+            { "\033[6n",          { "\033[{POS}R", }},
+            { "\033[?6n",         { "\033[?{POS}R", }},
+            { "\033[>q",          { "", }},
+            { "\033[?2026$p",     { "\033[?2026;1$y", }},
+            { "\033[1x",          { "", }},
+            { "\033]4;255;?\007", { "", }},
+            { "\033P+q544e\033\\",{ "" }},
+        },
+        "Type: unknown full featured(0) safe-CPR seq:>=",
+        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR)}), // should have all compliant capabilites. See above for details
         "",
         WithoutGlitchPatching
     },
@@ -198,12 +236,13 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R", }},
             { "\033[?6n",         { "\033[?{POS}R", }},
             { "\033[>q",          { "\033P>|Someterm 34.56\033\\", }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "", }},
             { "\033]4;255;?\007", { "", }},
             { "\033P+q544e\033\\",{ "" }},
         },
         "Type: unknown full featured(0) safe-CPR seq:>=",
-        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR)}), // should have all compliant capabilites.
+        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR), C(SYNCHRONIZED_UPDATE)}), // should have all compliant capabilites.
             // excluding CURSOR_SHAPE_OSC50 because it's konsole specific and non standard
             // excluding 88_COLOR because it reduces 256 color palette to 88 color.
         "Someterm 34.56",
@@ -221,12 +260,13 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R", }},
             { "\033[?6n",         { "\033[{POS}R", }},
             { "\033[>q",          { "", }},
+            { "\033[?2026$p",     { "", }},
             { "\033[1x",          { "", }},
             { "\033]4;255;?\007", { "", }},
             { "\033P+q544e\033\\",{ "" }},
         },
         "Type: unknown full featured(0)  seq:>=",
-        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR)}), // should have all compliant capabilites.
+        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR), C(SYNCHRONIZED_UPDATE)}), // should have all compliant capabilites.
             // excluding CURSOR_SHAPE_OSC50 because it's konsole specific and non standard
             // excluding 88_COLOR because it reduces 256 color palette to 88 color.
         "",
@@ -244,12 +284,13 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R", }},
             { "\033[?6n",         { "\033[{POS}R", }},
             { "\033[>q",          { "\033P>|Someterm 34.56\033\\", }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "", }},
             { "\033]4;255;?\007", { "", }},
             { "\033P+q544e\033\\",{ "" }},
         },
         "Type: unknown full featured(0)  seq:>=",
-        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR)}), // should have all compliant capabilites.
+        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR), C(SYNCHRONIZED_UPDATE)}), // should have all compliant capabilites.
             // excluding CURSOR_SHAPE_OSC50 because it's konsole specific and non standard
             // excluding 88_COLOR because it reduces 256 color palette to 88 color.
         "Someterm 34.56",
@@ -267,12 +308,13 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R", }},
             { "\033[?6n",         { "", }},
             { "\033[>q",          { "", }},
+            { "\033[?2026$p",     { "", }},
             { "\033[1x",          { "", }},
             { "\033]4;255;?\007", { "", }},
             { "\033P+q544e\033\\",{ "" }},
         },
         "Type: unknown full featured(0)  seq:>=",
-        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR)}), // should have all compliant capabilites. See above for details
+        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR), C(SYNCHRONIZED_UPDATE)}), // should have all compliant capabilites. See above for details
         "",
         WithoutGlitchPatching
     },
@@ -288,12 +330,13 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R", }},
             { "\033[?6n",         { "", }},
             { "\033[>q",          { "\033P>|Someterm 34.56\033\\", }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "", }},
             { "\033]4;255;?\007", { "", }},
             { "\033P+q544e\033\\",{ "" }},
         },
         "Type: unknown full featured(0)  seq:>=",
-        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR)}), // should have all compliant capabilites. See above for details
+        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR), C(SYNCHRONIZED_UPDATE)}), // should have all compliant capabilites. See above for details
         "Someterm 34.56",
         WithoutGlitchPatching
     },
@@ -309,12 +352,13 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R", }},
             { "\033[?6n",         { "\033[?{POS}R", }},
             { "\033[>q",          { "", }},
+            { "\033[?2026$p",     { "", }},
             { "\033[1x",          { "", }},
             { "\033]4;255;?\007", { "", }},
             { "\033P+q544e\033\\",{ "" }},
         },
         "Type: unknown full featured(0) safe-CPR seq:>=",
-        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR)}), // should have all compliant capabilites.
+        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR), C(SYNCHRONIZED_UPDATE)}), // should have all compliant capabilites.
             // excluding CURSOR_SHAPE_OSC50 because it's konsole specific and non standard
             // excluding 88_COLOR because it reduces 256 color palette to 88 color.
         "",
@@ -332,12 +376,13 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R", }},
             { "\033[?6n",         { "\033[?{POS}R", }},
             { "\033[>q",          { "\033P>|Someterm 34.56\033\\", }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "", }},
             { "\033]4;255;?\007", { "", }},
             { "\033P+q544e\033\\",{ "" }},
         },
         "Type: unknown full featured(0) safe-CPR seq:>=",
-        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR)}), // should have all compliant capabilites.
+        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR), C(SYNCHRONIZED_UPDATE)}), // should have all compliant capabilites.
             // excluding CURSOR_SHAPE_OSC50 because it's konsole specific and non standard
             // excluding 88_COLOR because it reduces 256 color palette to 88 color.
         "Someterm 34.56",
@@ -355,12 +400,13 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R", }},
             { "\033[?6n",         { "\033[{POS}R", }},
             { "\033[>q",          { "", }},
+            { "\033[?2026$p",     { "", }},
             { "\033[1x",          { "", }},
             { "\033]4;255;?\007", { "", }},
             { "\033P+q544e\033\\",{ "" }},
         },
         "Type: unknown full featured(0)  seq:>=",
-        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR)}), // should have all compliant capabilites.
+        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR), C(SYNCHRONIZED_UPDATE)}), // should have all compliant capabilites.
             // excluding CURSOR_SHAPE_OSC50 because it's konsole specific and non standard
             // excluding 88_COLOR because it reduces 256 color palette to 88 color.
         "",
@@ -378,12 +424,13 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R", }},
             { "\033[?6n",         { "\033[{POS}R", }},
             { "\033[>q",          { "\033P>|Someterm 34.56\033\\", }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "", }},
             { "\033]4;255;?\007", { "", }},
             { "\033P+q544e\033\\",{ "" }},
         },
         "Type: unknown full featured(0)  seq:>=",
-        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR)}), // should have all compliant capabilites.
+        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR), C(SYNCHRONIZED_UPDATE)}), // should have all compliant capabilites.
             // excluding CURSOR_SHAPE_OSC50 because it's konsole specific and non standard
             // excluding 88_COLOR because it reduces 256 color palette to 88 color.
         "Someterm 34.56",
@@ -401,12 +448,13 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R", }},
             { "\033[?6n",         { "", }},
             { "\033[>q",          { "", }},
+            { "\033[?2026$p",     { "", }},
             { "\033[1x",          { "", }},
             { "\033]4;255;?\007", { "", }},
             { "\033P+q544e\033\\",{ "" }},
         },
         "Type: unknown full featured(0)  seq:>=",
-        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR)}), // should have all compliant capabilites. See above for details
+        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR), C(SYNCHRONIZED_UPDATE)}), // should have all compliant capabilites. See above for details
         "",
         WithoutGlitchPatching
     },
@@ -422,12 +470,13 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R", }},
             { "\033[?6n",         { "", }},
             { "\033[>q",          { "\033P>|Someterm 34.56\033\\", }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "", }},
             { "\033]4;255;?\007", { "", }},
             { "\033P+q544e\033\\",{ "" }},
         },
         "Type: unknown full featured(0)  seq:>=",
-        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR)}), // should have all compliant capabilites. See above for details
+        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR), C(SYNCHRONIZED_UPDATE)}), // should have all compliant capabilites. See above for details
         "Someterm 34.56",
         WithoutGlitchPatching
     },
@@ -443,12 +492,13 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R", }},
             { "\033[?6n",         { "", }},
             { "\033[>q",          { "", }},
+            { "\033[?2026$p",     { "", }},
             { "\033[1x",          { "\033[3;1;1;128;128;1;0x", }},
             { "\033]4;255;?\007", { "", }},
             { "\033P+q544e\033\\",{ "" }},
         },
         "Type: unknown full featured(0)  seq:>=",
-        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR)}), // should have all compliant capabilites. See above for details
+        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR), C(SYNCHRONIZED_UPDATE)}), // should have all compliant capabilites. See above for details
         "",
         WithoutGlitchPatching
     },
@@ -464,12 +514,13 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R", }},
             { "\033[?6n",         { "", }},
             { "\033[>q",          { "\033P>|Someterm 34.56\033\\", }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;128;128;1;0x", }},
             { "\033]4;255;?\007", { "", }},
             { "\033P+q544e\033\\",{ "" }},
         },
         "Type: unknown full featured(0)  seq:>=",
-        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR)}), // should have all compliant capabilites. See above for details
+        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR), C(SYNCHRONIZED_UPDATE)}), // should have all compliant capabilites. See above for details
         "Someterm 34.56",
         WithoutGlitchPatching
     },
@@ -485,12 +536,13 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R", }},
             { "\033[?6n",         { "", }},
             { "\033[>q",          { "", }},
+            { "\033[?2026$p",     { "", }},
             { "\033[1x",          { "\033[3;1;1;128;128;1;0x", }},
             { "\033]4;255;?\007", { "", }},
             { "\033P+q544e\033\\",{ "" }},
         },
         "Type: unknown full featured(0)  seq:>=",
-        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR)}), // should have all compliant capabilites. See above for details
+        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR), C(SYNCHRONIZED_UPDATE)}), // should have all compliant capabilites. See above for details
         "",
         WithoutGlitchPatching
     },
@@ -506,12 +558,13 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R", }},
             { "\033[?6n",         { "", }},
             { "\033[>q",          { "\033P>|Someterm 34.56\033\\", }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;128;128;1;0x", }},
             { "\033]4;255;?\007", { "", }},
             { "\033P+q544e\033\\",{ "" }},
         },
         "Type: unknown full featured(0)  seq:>=",
-        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR)}), // should have all compliant capabilites. See above for details
+        allCapsBut({C(CURSOR_SHAPE_OSC50), C(88_COLOR), C(SYNCHRONIZED_UPDATE)}), // should have all compliant capabilites. See above for details
         "Someterm 34.56",
         WithoutGlitchPatching
     },
@@ -527,6 +580,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS}R" }},
             { "\033[>q",          { "", "XXXX" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[?x" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\007" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -534,7 +588,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: vte(2800) safe-CPR seq:",
         { C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE),
+          C(SCROLL_REGION) },
         "",
         WithoutGlitchPatching
     },
@@ -550,6 +605,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS}R" }},
             { "\033[>q",          { "", "XXXX" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[?x" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\007" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -557,7 +613,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: vte(3600) safe-CPR seq:",
         { C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE),
+          C(SCROLL_REGION) },
         "",
         WithoutGlitchPatching
     },
@@ -573,6 +630,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS}R" }},
             { "\033[>q",          { "", "XXXX" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[?x" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\007" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -580,7 +638,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: vte(4000) safe-CPR seq:",
         { C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE),
+          C(SCROLL_REGION) },
         "",
         WithoutGlitchPatching
     },
@@ -596,6 +655,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS};1R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;120;120;1;0x" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\033\\" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -603,7 +663,9 @@ static const std::initializer_list<TestCase> tests = {
         "Type: vte(5400) safe-CPR seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(TITLE_RESTORE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE),
+          C(SCROLL_REGION),
+          C(REPEAT_CHAR) },
         "",
         WithoutGlitchPatching
     },
@@ -619,6 +681,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\033\\" }},
             { "\033P+q544e\033\\",{ "\033P1+r544e=787465726d2d6b69747479\033\\" }},
@@ -642,6 +705,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\033\\" }},
             { "\033P+q544e\033\\",{ "\033P1+r544e=787465726d2d6b69747479\033\\" }},
@@ -649,7 +713,9 @@ static const std::initializer_list<TestCase> tests = {
         "Type: kitty(14) safe-CPR seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(TITLE_RESTORE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION),
+          C(REPEAT_CHAR) },
         "",
         WithoutGlitchPatching
     },
@@ -665,6 +731,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS}R" }},
             { "\033[>q",          { "\033P>|kitty(0.31.0)\033\\" }},
+            { "\033[?2026$p",     { "\033[?2026;2$y" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\033\\" }},
             { "\033P+q544e\033\\", { "\033P1+r544e=787465726d2d6b69747479\033\\" }},
@@ -672,7 +739,10 @@ static const std::initializer_list<TestCase> tests = {
         "Type: kitty(31) safe-CPR seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(TITLE_RESTORE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION),
+          C(REPEAT_CHAR),
+          C(SYNCHRONIZED_UPDATE) },
         "kitty(0.31.0)",
         WithoutGlitchPatching
     },
@@ -688,6 +758,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -711,6 +782,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -734,6 +806,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -757,6 +830,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -780,6 +854,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "\033P>|fictional\033\\" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -803,6 +878,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -825,6 +901,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -848,6 +925,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -871,6 +949,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -894,6 +973,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;120;120;1;0x" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -917,6 +997,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;120;120;1;0x" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\033\\" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -940,6 +1021,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[{POS}R" }},
             { "\033[>q",          { "\033P>|fictional\033\\" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;120;120;1;0x" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\033\\" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -963,6 +1045,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;120;120;1;0x" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\033\\" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -986,6 +1069,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;120;120;1;0x" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\033\\" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1009,6 +1093,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;120;120;1;0x" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\033\\" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1032,6 +1117,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;120;120;1;0x" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\033\\" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1055,6 +1141,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1078,6 +1165,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "\033P>|fictional\033\\" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1101,6 +1189,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[24;1R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1124,6 +1213,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[24;1R" }},
             { "\033[?6n",         { "\033[24;1R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;120;120;1;0x" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1147,6 +1237,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1170,6 +1261,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1193,6 +1285,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1216,6 +1309,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\007" }},
             { "\033P+q544e\033\\", { "" }},
@@ -1239,6 +1333,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "", "+q544e" }},
@@ -1263,6 +1358,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;112;112;1;0x" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "", "+q544e" }},
@@ -1270,7 +1366,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: konsole(0)  seq:>",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR), C(CURSOR_SHAPE_OSC50),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "",
         NeedsGlitchPatching
     },
@@ -1287,6 +1384,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;112;112;1;0x" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "", "+q544e" }},
@@ -1294,7 +1392,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: konsole(0)  seq:>",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR), C(CURSOR_SHAPE_OSC50),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "",
         NeedsGlitchPatching
     },
@@ -1311,6 +1410,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;112;112;1;0x" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "", "+q544e" }},
@@ -1318,7 +1418,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: konsole(0)  seq:>",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR), C(CURSOR_SHAPE_OSC50),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "",
         NeedsGlitchPatching
     },
@@ -1334,6 +1435,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;112;112;1;0x" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "", "+q544e" }},
@@ -1341,7 +1443,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: konsole(0)  seq:>",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR), C(CURSOR_SHAPE_OSC50),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "",
         NeedsGlitchPatching
     },
@@ -1357,6 +1460,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;112;112;1;0x" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1364,7 +1468,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: konsole(220370)  seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR), C(CURSOR_SHAPE_OSC50),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "",
         WithoutGlitchPatching
     },
@@ -1380,6 +1485,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "\033P>|Konsole 23.08.1\033\\" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;112;112;1;0x" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\007" }},
             { "\033P+q544e\033\\", { "" }},
@@ -1387,7 +1493,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: konsole(230801)  seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR), C(CURSOR_SHAPE_OSC50),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "Konsole 23.08.1",
         WithoutGlitchPatching
     },
@@ -1403,6 +1510,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS};1R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;112;112;1;0x" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\033\\" }},
             { "\033P+q544e\033\\",{ "\033P1+r544e=6D6C7465726D\033\\" }},
@@ -1410,7 +1518,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: mlterm(0) safe-CPR seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "",
         WithoutGlitchPatching
     },
@@ -1426,6 +1535,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS};1R" }},
             { "\033[>q",          { "\033P>|mlterm(3.9.3)\033\\" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;112;112;1;0x" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\033\\" }},
             { "\033P+q544e\033\\", { "\033P1+r544e=6D6C7465726D\033\\" }},
@@ -1433,7 +1543,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: mlterm(3009003) safe-CPR seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "mlterm(3.9.3)",
         WithoutGlitchPatching
     },
@@ -1449,6 +1560,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1472,6 +1584,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1495,6 +1608,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS}R" }},
             { "\033[>q",          { "\033P>|fictional\033\\" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1518,6 +1632,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "", "+q544e" }},
@@ -1541,6 +1656,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;112;112;1;0x" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\007" }},
             { "\033P+q544e\033\\", { "", "+q544e" }},
@@ -1564,6 +1680,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;112;112;1;0x" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "", "+q544e" }},
@@ -1571,7 +1688,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: screen(30915)  seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET),
-          C(7BIT_ST), C(CLEARED_COLORING_DEFCOLOR) },
+          C(7BIT_ST), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "",
         WithoutGlitchPatching
     },
@@ -1587,6 +1705,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\007" }},
             { "\033P+q544e\033\\",{ "\033P0+r\033\\" }},
@@ -1594,7 +1713,9 @@ static const std::initializer_list<TestCase> tests = {
         "Type: unknown full featured(0)  seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(TITLE_RESTORE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION),
+          C(REPEAT_CHAR) },
         "",
         WithoutGlitchPatching
     },
@@ -1610,6 +1731,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS};1R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1617,7 +1739,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: terminology(0) safe-CPR seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "",
         WithoutGlitchPatching
     },
@@ -1633,6 +1756,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS};1R" }},
             { "\033[>q",          { "\033P>|terminology 1.7.0\033\\" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1640,7 +1764,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: terminology(1007000) safe-CPR seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(TITLE_RESTORE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "terminology 1.7.0",
         WithoutGlitchPatching
     },
@@ -1656,6 +1781,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1679,6 +1805,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "", "+q544e" }},
@@ -1702,6 +1829,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1725,6 +1853,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1748,6 +1877,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1755,7 +1885,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: tmux(0)  seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "",
         WithoutGlitchPatching
     },
@@ -1771,6 +1902,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "\033P>|tmux 3.3a\033\\" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\", { "" }},
@@ -1778,7 +1910,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: tmux(3003000)  seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "tmux 3.3a",
         WithoutGlitchPatching
     },
@@ -1794,6 +1927,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "\033P>|fictional\033\\" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1801,7 +1935,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: tmux(0)  seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "fictional",
         WithoutGlitchPatching
     },
@@ -1817,6 +1952,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;128;128;1;0x" }},
             { "\033]4;255;?\007", { "\033]4;rgb:eeee/eeee/eeee\007" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1824,7 +1960,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: urxvt(0)  seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET),
-          C(CLEARED_COLORING), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "",
         WithoutGlitchPatching
     },
@@ -1840,6 +1977,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;128;128;1;0x" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1847,7 +1985,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: urxvt(0)  seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(88_COLOR),
-          C(CLEARED_COLORING), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "",
         WithoutGlitchPatching
     },
@@ -1863,6 +2002,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "\033P>|fictional\033\\" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;128;128;1;0x" }},
             { "\033]4;255;?\007", { "\033]4;rgb:eeee/eeee/eeee\007" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1870,7 +2010,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: urxvt(0)  seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET),
-          C(CLEARED_COLORING), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "fictional",
         WithoutGlitchPatching
     },
@@ -1886,6 +2027,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "\033P>|fictional\033\\" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;128;128;1;0x" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1893,7 +2035,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: urxvt(0)  seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(88_COLOR),
-          C(CLEARED_COLORING), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "fictional",
         WithoutGlitchPatching
     },
@@ -1909,6 +2052,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[{POS}R" }},
             { "\033[>q",          { "", "q" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "", ";255;?" }},
             { "\033P+q544e\033\\",{ "", "+q544e" }},
@@ -1932,6 +2076,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -1956,6 +2101,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "\033P>|foot(1.13.1)\033\\" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\007" }},
             { "\033P+q544e\033\\", { "\033P1+r544e=666F6F74\033\\" }},
@@ -1963,7 +2109,9 @@ static const std::initializer_list<TestCase> tests = {
         "Type: unknown full featured(0)  seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(TITLE_RESTORE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION),
+          C(REPEAT_CHAR) },
         "foot(1.13.1)",
         WithoutGlitchPatching
     },
@@ -1979,6 +2127,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\007" }},
             { "\033P+q544e\033\\", { "" }},
@@ -2003,6 +2152,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\", { "", "+q544e" }},
@@ -2026,6 +2176,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\033\\" }},
             { "\033P+q544e\033\\", { "" }},
@@ -2049,6 +2200,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "", "+q544e" }},
@@ -2072,6 +2224,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { TODO }}, // actually leaves terminal in ST state in netbsd (openbsd is robust)
             { "\033P+q544e\033\\",{ "" }},
@@ -2095,6 +2248,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:ee/ee/ed\007" }},
             { "\033P+q544e\033\\",{ "\033P1+r544E=695465726d32\033\\" }},
@@ -2102,7 +2256,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: iterm2(0) safe-CPR seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "",
         WithoutGlitchPatching
     },
@@ -2118,6 +2273,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS}R" }},
             { "\033[>q",          { "\033P>|iTerm2 3.4.20201030-nightly\033\\" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:ee/ee/ed\007" }},
             { "\033P+q544e\033\\",{ "\033P1+r544E=695465726d32\033\\" }},
@@ -2125,7 +2281,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: iterm2(3004000) safe-CPR seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "iTerm2 3.4.20201030-nightly",
         WithoutGlitchPatching
     },
@@ -2141,6 +2298,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;112;112;1;0x" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\007" }},
             { "\033P+q544e\033\\",{ "", "+q544e" }},
@@ -2148,7 +2306,8 @@ static const std::initializer_list<TestCase> tests = {
         "Type: apple terminal(0)  seq:>",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET),
-          C(7BIT_ST), C(CLEARED_COLORING_DEFCOLOR) },
+          C(7BIT_ST), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION) },
         "",
         WithoutGlitchPatching
     },
@@ -2164,6 +2323,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS}R" }},
             { "\033[>q",          { "\033P>|mintty 3.2.0\033\\" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;120;120;1;0x" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\033\\" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -2171,7 +2331,9 @@ static const std::initializer_list<TestCase> tests = {
         "Type: mintty(30200) safe-CPR seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(TITLE_RESTORE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(MAY_TRY_TAGGED_PASTE), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION),
+          C(REPEAT_CHAR) },
         "mintty 3.2.0",
         WithoutGlitchPatching
     },
@@ -2187,6 +2349,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "", "+q544e" }},
@@ -2210,6 +2373,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ TODO }},
@@ -2233,6 +2397,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -2240,7 +2405,9 @@ static const std::initializer_list<TestCase> tests = {
         "Type: microsoft terminal(0)  seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION),
+          C(REPEAT_CHAR) },
         "",
         WithoutGlitchPatching
     },
@@ -2256,6 +2423,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;1;1;128;128;1;0x" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -2263,7 +2431,9 @@ static const std::initializer_list<TestCase> tests = {
         "Type: microsoft terminal(0) safe-CPR seq:>=",
         { C(CSI_POSTFIX_MOD), C(MAY_TRY_CURSOR_SHAPE), C(MAY_TRY_CURSOR_SHAPE_BAR),
           C(EXTENDED_CHARSET), C(TRUECOLOR_MAYBE_SUPPORTED), C(TRUECOLOR_SUPPORTED),
-          C(CLEARED_COLORING), C(7BIT_ST), C(CLEARED_COLORING_DEFCOLOR) },
+          C(CLEARED_COLORING), C(7BIT_ST), C(CLEARED_COLORING_DEFCOLOR),
+          C(SCROLL_REGION),
+          C(REPEAT_CHAR) },
         "",
         WithoutGlitchPatching
     },
@@ -2279,6 +2449,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[{POS};1R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -2302,6 +2473,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "", "+q544e" }},
@@ -2325,6 +2497,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -2348,6 +2521,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[?{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "\033[3;5;2;64;64;1;0x" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -2371,6 +2545,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "", "q" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -2394,6 +2569,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "" }},
             { "\033[>q",          { "", "q" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "" }},
             { "\033P+q544e\033\\",{ "", "+q544e" }},
@@ -2417,6 +2593,7 @@ static const std::initializer_list<TestCase> tests = {
             { "\033[6n",          { "\033[{POS}R" }},
             { "\033[?6n",         { "\033[{POS}R" }},
             { "\033[>q",          { "" }},
+            { "\033[?2026$p",     { "" }},
             { "\033[1x",          { "" }},
             { "\033]4;255;?\007", { "\033]4;255;rgb:eeee/eeee/eeee\007" }},
             { "\033P+q544e\033\\",{ "" }},
@@ -2,6 +2,7 @@
 #include <string.h>
 #include <map>
 #include <limits>
+#include <vector>
 
 #ifndef BUNDLED_CATCH2
 #ifdef CATCH3
@@ -225,6 +226,60 @@ TEST_CASE("resize") {
 }
 
 
+TEST_CASE("resize - preserves contents") {
+    Fixture f{80, 24};
+    termpaint_surface_write_with_colors(f.surface, 0, 0, "ab", TERMPAINT_COLOR_RED, TERMPAINT_COLOR_BLACK);
+    termpaint_surface_write_with_colors(f.surface, 8, 1, "あ", TERMPAINT_DEFAULT_COLOR, TERMPAINT_COLOR_BLUE);
+
+    termpaint_surface_resize(f.surface, 100, 30);
+
+    checkEmptyPlusSome(f.surface, {
+        {{ 0, 0 }, singleWideChar("a").withFg(TERMPAINT_COLOR_RED).withBg(TERMPAINT_COLOR_BLACK)},
+        {{ 1, 0 }, singleWideChar("b").withFg(TERMPAINT_COLOR_RED).withBg(TERMPAINT_COLOR_BLACK)},
+        {{ 8, 1 }, doubleWideChar("あ").withBg(TERMPAINT_COLOR_BLUE)},
+    });
+
+    termpaint_surface_resize(f.surface, 9, 2);
+
+    checkEmptyPlusSome(f.surface, {
+        {{ 0, 0 }, singleWideChar("a").withFg(TERMPAINT_COLOR_RED).withBg(TERMPAINT_COLOR_BLACK)},
+        {{ 1, 0 }, singleWideChar("b").withFg(TERMPAINT_COLOR_RED).withBg(TERMPAINT_COLOR_BLACK)},
+        {{ 8, 1 }, singleWideChar(" ").withBg(TERMPAINT_COLOR_BLUE)},
+    });
+}
+
+
+TEST_CASE("resize - wider with swapped buffers") {
+    Fixture f{10, 3};
+    termpaint_terminal_set_swap_buffers(f.terminal, true);
+    termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_surface_write_with_colors(f.surface, 0, 0, "Hello", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, false);
+
+    termpaint_surface_resize(f.surface, 12, 3);
+
+    auto checkNoInternalCells = [&] {
+        for (int y = 0; y < 3; y++) {
+            for (int x = 0; x < 12; x++) {
+                int len, left, right;
+                const char *text = termpaint_surface_peek_text(f.surface, x, y, &len, &left, &right);
+                CAPTURE(x, y);
+                CHECK(std::string(text, len) != "\x01");
+            }
+        }
+    };
+
+    termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_surface_write_with_colors(f.surface, 0, 0, "Hello", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, false);
+    checkNoInternalCells();
+
+    termpaint_surface_write_with_colors(f.surface, 0, 1, "World", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, false);
+    checkNoInternalCells();
+}
+
+
 TEST_CASE("resize - oversized") {
     Fixture f{80, 24};
     termpaint_surface_resize(f.surface, std::numeric_limits<int>::max() / 2, std::numeric_limits<int>::max() / 2);
@@ -397,6 +452,77 @@ TEST_CASE("write clear char") {
 }
 
 
+TEST_CASE("simple text - long ascii run followed by combining char") {
+    Fixture f{80, 6};
+    termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_surface_write_with_colors(f.surface, 10, 3, "0123456789abcde\u0308x",
+                                        TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+
+    checkEmptyPlusSome(f.surface, {
+        {{ 10, 3 }, singleWideChar("0")},
+        {{ 11, 3 }, singleWideChar("1")},
+        {{ 12, 3 }, singleWideChar("2")},
+        {{ 13, 3 }, singleWideChar("3")},
+        {{ 14, 3 }, singleWideChar("4")},
+        {{ 15, 3 }, singleWideChar("5")},
+        {{ 16, 3 }, singleWideChar("6")},
+        {{ 17, 3 }, singleWideChar("7")},
+        {{ 18, 3 }, singleWideChar("8")},
+        {{ 19, 3 }, singleWideChar("9")},
+        {{ 20, 3 }, singleWideChar("a")},
+        {{ 21, 3 }, singleWideChar("b")},
+        {{ 22, 3 }, singleWideChar("c")},
+        {{ 23, 3 }, singleWideChar("d")},
+        {{ 24, 3 }, singleWideChar("e\u0308")},
+        {{ 25, 3 }, singleWideChar("x")},
+    });
+}
+
+TEST_CASE("write spans") {
+    Fixture f{80, 24};
+
+    usurface_ptr s1, s2;
+    s1.reset(termpaint_terminal_new_surface(f.terminal, 40, 10));
+    s2.reset(termpaint_terminal_new_surface(f.terminal, 40, 10));
+
+    uattr_ptr red, blue;
+    red.reset(termpaint_attr_new(TERMPAINT_COLOR_RED, TERMPAINT_DEFAULT_COLOR));
+    blue.reset(termpaint_attr_new(TERMPAINT_COLOR_BLUE, TERMPAINT_DEFAULT_COLOR));
+    termpaint_attr_set_patch(blue, true, "asdf", "dfgh");
+
+    const termpaint_write_span spans[] = {
+        { 2, 5, "Sample", -1, red },
+        { 4, 1, "あえ", -1, blue },
+        { 4, 5, "overlapping", 4, blue },
+        { 36, 2, "clipped", -1, red },
+        { 0, 12, "outside", -1, red },
+        { 6, 1, "x", -1, red },
+    };
+
+    SECTION("surface") {
+        termpaint_surface_write_spans(s1, spans, sizeof(spans) / sizeof(spans[0]));
+        for (const termpaint_write_span &span: spans) {
+            termpaint_surface_write_with_len_attr(s2, span.x, span.y, span.text,
+                                                  span.len < 0 ? strlen(span.text) : span.len, span.attr);
+        }
+        CHECK(termpaint_surface_peek_fg_color(s1, 4, 5) == TERMPAINT_COLOR_BLUE);
+    }
+
+    SECTION("view") {
+        usurface_ptr view;
+        view.reset(termpaint_surface_new_view(s1, 3, 2, 30, 6));
+        termpaint_surface_write_spans(view, spans, sizeof(spans) / sizeof(spans[0]));
+        view.reset(termpaint_surface_new_view(s2, 3, 2, 30, 6));
+        for (const termpaint_write_span &span: spans) {
+            termpaint_surface_write_with_len_attr(view, span.x, span.y, span.text,
+                                                  span.len < 0 ? strlen(span.text) : span.len, span.attr);
+        }
+        CHECK(termpaint_surface_peek_fg_color(s1, 7, 7) == TERMPAINT_COLOR_BLUE);
+    }
+
+    CHECK(termpaint_surface_same_contents(s1, s2));
+}
+
 TEST_CASE("vanish chars") {
     Fixture f{80, 24};
     termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
@@ -482,6 +608,26 @@ TEST_CASE("rgb colors") {
 }
 
 
+TEST_CASE("many distinct colors") {
+    // white-box: Attributes are shared between cells, unused attributes are collected when too many accumulate.
+    Fixture f{80, 24};
+    termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+
+    for (int round = 0; round < 8; round++) {
+        std::map<std::tuple<int,int>, Cell> expected;
+        for (int y = 0; y < 24; y++) {
+            for (int x = 0; x < 80; x++) {
+                termpaint_surface_write_with_colors(f.surface, x, y, "x", TERMPAINT_RGB_COLOR(round, x, y),
+                                                    TERMPAINT_RGB_COLOR(y, round, x));
+                expected[{x, y}] = singleWideChar("x").withFg(TERMPAINT_RGB_COLOR(round, x, y))
+                        .withBg(TERMPAINT_RGB_COLOR(y, round, x));
+            }
+        }
+        checkEmptyPlusSome(f.surface, expected);
+    }
+}
+
+
 TEST_CASE("named fg colors") {
     Fixture f{80, 24};
     termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
@@ -668,15 +814,14 @@ TEST_CASE("simple patch") {
 }
 
 
-TEST_CASE("too many patches") {
-    // white-box: There is an internal limit of 255 different patch settings at one time.
+TEST_CASE("many patches - concurrent") {
     Fixture f{80, 24};
     termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
 
     termpaint_attr* attr_url = termpaint_attr_new(TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
     using namespace std::literals;
     std::map<std::tuple<int,int>, Cell> expected;
-    for (int i = 0; i < 256; i++) {
+    for (int i = 0; i < 80 * 24; i++) {
         const std::string setup = "\033]8;;http://example.com\033\\"s + std::to_string(i);
         termpaint_attr_set_patch(attr_url, true, setup.data(), "\033]8;;\033\\");
         termpaint_surface_write_with_attr(f.surface, i % 80, i / 80, "x", attr_url);
@@ -684,14 +829,11 @@ TEST_CASE("too many patches") {
     }
     termpaint_attr_free(attr_url);
 
-    expected[{255 % 80, 255 / 80}] = singleWideChar("x");
-
     checkEmptyPlusSome(f.surface, expected);
 }
 
 
 TEST_CASE("many patches - sequential") {
-    // white-box: There is an internal limit of 255 different patch settings at one time.
     Fixture f{80, 24};
     termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
 
@@ -709,6 +851,57 @@ TEST_CASE("many patches - sequential") {
 }
 
 
+TEST_CASE("many patches - replaced while others are kept") {
+    Fixture f{80, 24};
+    termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+
+    termpaint_attr* attr_url = termpaint_attr_new(TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    using namespace std::literals;
+    std::map<std::tuple<int,int>, Cell> expected;
+    for (int i = 0; i < 40; i++) {
+        const std::string setup = "\033]8;;http://example.com\033\\"s + std::to_string(i);
+        termpaint_attr_set_patch(attr_url, true, setup.data(), "\033]8;;\033\\");
+        termpaint_surface_write_with_attr(f.surface, i, 0, "x", attr_url);
+        expected[{i, 0}] = singleWideChar("x").withPatch(true, setup, "\033]8;;\033\\");
+    }
+    // unused patches are freed when the patch table is full, the ones still in use must stay
+    for (int i = 0; i < 300; i++) {
+        const std::string setup = "\033]8;;http://example.org\033\\"s + std::to_string(i);
+        termpaint_attr_set_patch(attr_url, true, setup.data(), "\033]8;;\033\\");
+        termpaint_surface_write_with_attr(f.surface, 0, 1, "y", attr_url);
+        expected[{0, 1}] = singleWideChar("y").withPatch(true, setup, "\033]8;;\033\\");
+    }
+    termpaint_attr_free(attr_url);
+
+    checkEmptyPlusSome(f.surface, expected);
+}
+
+
+TEST_CASE("patch - attr reused after changing patch") {
+    Fixture f{80, 24};
+    termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+
+    termpaint_attr* attr_url = termpaint_attr_new(TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_attr_set_patch(attr_url, true, "\033]8;;http://example.com\033\\", "\033]8;;\033\\");
+    termpaint_surface_write_with_attr(f.surface, 3, 3, "A", attr_url);
+    termpaint_attr* attr_clone = termpaint_attr_clone(attr_url);
+    termpaint_attr_set_patch(attr_url, false, "\033]8;;http://example.org\033\\", "\033]8;;\033\\");
+    termpaint_surface_write_with_attr(f.surface, 4, 3, "B", attr_url);
+    termpaint_surface_write_with_attr(f.surface, 5, 3, "C", attr_clone);
+    termpaint_attr_set_patch(attr_url, false, nullptr, nullptr);
+    termpaint_surface_write_with_attr(f.surface, 6, 3, "D", attr_url);
+    termpaint_attr_free(attr_url);
+    termpaint_attr_free(attr_clone);
+
+    checkEmptyPlusSome(f.surface, {
+        {{ 3, 3 }, singleWideChar("A").withPatch(true, "\033]8;;http://example.com\033\\", "\033]8;;\033\\")},
+        {{ 4, 3 }, singleWideChar("B").withPatch(false, "\033]8;;http://example.org\033\\", "\033]8;;\033\\")},
+        {{ 5, 3 }, singleWideChar("C").withPatch(true, "\033]8;;http://example.com\033\\", "\033]8;;\033\\")},
+        {{ 6, 3 }, singleWideChar("D")},
+    });
+}
+
+
 TEST_CASE("write with right clipping") {
     Fixture f{80, 24};
     termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
@@ -1736,6 +1929,64 @@ TEST_CASE("off screen: compare") {
 }
 
 
+TEST_CASE("off screen: find difference") {
+    Fixture f{80, 24};
+
+    usurface_ptr s1, s2;
+    s1.reset(termpaint_terminal_new_surface(f.terminal, 80, 24));
+    s2.reset(termpaint_terminal_new_surface(f.terminal, 80, 24));
+
+    termpaint_surface_clear(s1, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_surface_clear(s2, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+
+    int x = 42, y = 42;
+
+    SECTION("identical") {
+        uattr_ptr attr;
+        attr.reset(termpaint_attr_new(TERMPAINT_COLOR_RED, TERMPAINT_DEFAULT_COLOR));
+        termpaint_attr_set_patch(attr, true, "asdf", "dfgh");
+        termpaint_surface_write_with_attr(s1, 10, 3, "sあmple", attr);
+        termpaint_surface_write_with_attr(s2, 10, 3, "sあmple", attr);
+
+        CHECK_FALSE(termpaint_surface_find_difference(s1, s2, &x, &y));
+        CHECK(x == 42);
+        CHECK(y == 42);
+    }
+
+    SECTION("first difference") {
+        termpaint_surface_write_with_colors(s1, 10, 3, "sample", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        termpaint_surface_write_with_colors(s2, 10, 3, "samPLe", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        termpaint_surface_write_with_colors(s2, 5, 7, "x", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+
+        CHECK(termpaint_surface_find_difference(s1, s2, &x, &y));
+        CHECK(x == 13);
+        CHECK(y == 3);
+    }
+
+    SECTION("views") {
+        termpaint_surface_write_with_colors(s1, 10, 3, "sample", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        termpaint_surface_write_with_colors(s2, 20, 5, "sample", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        termpaint_surface_write_with_colors(s2, 22, 6, "x", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+
+        usurface_ptr v1, v2;
+        v1.reset(termpaint_surface_new_view(s1, 8, 2, 10, 3));
+        v2.reset(termpaint_surface_new_view(s2, 18, 4, 10, 3));
+
+        CHECK(termpaint_surface_find_difference(v1, v2, &x, &y));
+        CHECK(x == 4);
+        CHECK(y == 2);
+    }
+
+    SECTION("different size") {
+        s2.reset(termpaint_terminal_new_surface(f.terminal, 80, 12));
+
+        CHECK(termpaint_surface_find_difference(s1, s2, &x, &y));
+        CHECK(x == -1);
+        CHECK(y == -1);
+    }
+}
+
+
 TEST_CASE("attr") {
     Fixture f{80, 24};
     termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
@@ -2018,6 +2269,189 @@ TEST_CASE("off-screen: resize") {
 }
 
 
+TEST_CASE("view") {
+    Fixture f{80, 24};
+    termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+
+    usurface_ptr view;
+    view.reset(termpaint_surface_new_view(f.surface, 10, 5, 6, 3));
+
+    CHECK(termpaint_surface_width(view) == 6);
+    CHECK(termpaint_surface_height(view) == 3);
+
+    SECTION("write") {
+        termpaint_surface_write_with_colors(view, 2, 1, "Sample", TERMPAINT_COLOR_RED, TERMPAINT_DEFAULT_COLOR);
+        termpaint_surface_write_with_colors(view, 0, 3, "Outside", TERMPAINT_COLOR_RED, TERMPAINT_DEFAULT_COLOR);
+        termpaint_surface_write_with_colors(view, 5, 0, "あ", TERMPAINT_COLOR_RED, TERMPAINT_DEFAULT_COLOR);
+
+        checkEmptyPlusSome(f.surface, {
+            {{ 15, 5 }, singleWideChar(" ").withFg(TERMPAINT_COLOR_RED)},
+            {{ 12, 6 }, singleWideChar("S").withFg(TERMPAINT_COLOR_RED)},
+            {{ 13, 6 }, singleWideChar("a").withFg(TERMPAINT_COLOR_RED)},
+            {{ 14, 6 }, singleWideChar("m").withFg(TERMPAINT_COLOR_RED)},
+            {{ 15, 6 }, singleWideChar("p").withFg(TERMPAINT_COLOR_RED)},
+        });
+        CHECK(termpaint_surface_peek_fg_color(view, 2, 1) == TERMPAINT_COLOR_RED);
+        CHECK(termpaint_surface_peek_fg_color(view, 6, 1) == 0);
+    }
+
+    SECTION("clear") {
+        termpaint_surface_clear(view, TERMPAINT_COLOR_RED, TERMPAINT_COLOR_BLUE);
+
+        std::map<std::tuple<int,int>, Cell> expected;
+        for (int y = 5; y < 8; y++) {
+            for (int x = 10; x < 16; x++) {
+                expected[{x, y}] = singleWideChar(TERMPAINT_ERASED).withFg(TERMPAINT_COLOR_RED).withBg(TERMPAINT_COLOR_BLUE);
+            }
+        }
+        checkEmptyPlusSome(f.surface, expected);
+    }
+
+    SECTION("copy") {
+        termpaint_surface_write_with_colors(f.surface, 11, 6, "abc", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        usurface_ptr copy;
+        copy.reset(termpaint_surface_duplicate(view));
+        CHECK(termpaint_surface_width(copy) == 6);
+        CHECK(termpaint_surface_height(copy) == 3);
+        CHECK(termpaint_surface_same_contents(copy, view));
+        int len;
+        const char *text = termpaint_surface_peek_text(copy, 1, 1, &len, nullptr, nullptr);
+        CHECK(std::string(text, len) == "a");
+    }
+
+    SECTION("parent resize") {
+        termpaint_surface_resize(f.surface, 12, 24);
+        CHECK(termpaint_surface_width(view) == 2);
+        CHECK(termpaint_surface_height(view) == 3);
+        termpaint_surface_resize(f.surface, 80, 24);
+        CHECK(termpaint_surface_width(view) == 6);
+    }
+
+    SECTION("parent freed first") {
+        usurface_ptr parent;
+        parent.reset(termpaint_terminal_new_surface(f.terminal, 20, 10));
+        usurface_ptr view2;
+        view2.reset(termpaint_surface_new_view(parent, 5, 5, 40, 40));
+        CHECK(termpaint_surface_width(view2) == 15);
+        CHECK(termpaint_surface_height(view2) == 5);
+        parent.reset();
+        CHECK(termpaint_surface_width(view2) == 0);
+        CHECK(termpaint_surface_height(view2) == 0);
+    }
+}
+
+
+TEST_CASE("duplicate - copy on write") {
+    Fixture f{80, 24};
+    termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+
+    termpaint_attr* attr_url = termpaint_attr_new(TERMPAINT_COLOR_RED, TERMPAINT_DEFAULT_COLOR);
+    termpaint_attr_set_patch(attr_url, true, "\033]8;;http://example.com\033\\", "\033]8;;\033\\");
+    termpaint_surface_write_with_attr(f.surface, 3, 3, "Ae\u0308\u0308\u0308\u0308", attr_url);
+    termpaint_attr_free(attr_url);
+
+    const std::map<std::tuple<int,int>, Cell> expected = {
+        {{ 3, 3 }, singleWideChar("A").withFg(TERMPAINT_COLOR_RED)
+                .withPatch(true, "\033]8;;http://example.com\033\\", "\033]8;;\033\\")},
+        {{ 4, 3 }, singleWideChar("e\u0308\u0308\u0308\u0308").withFg(TERMPAINT_COLOR_RED)
+                .withPatch(true, "\033]8;;http://example.com\033\\", "\033]8;;\033\\")},
+    };
+
+    usurface_ptr dup;
+    dup.reset(termpaint_surface_duplicate(f.surface));
+    CHECK(termpaint_surface_same_contents(f.surface, dup));
+
+    SECTION("change original") {
+        termpaint_surface_write_with_colors(f.surface, 0, 0, "x", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        checkEmptyPlusSome(dup, expected);
+    }
+
+    SECTION("change duplicate") {
+        termpaint_surface_write_with_colors(dup, 0, 0, "x", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        checkEmptyPlusSome(f.surface, expected);
+    }
+
+    SECTION("free original") {
+        usurface_ptr original;
+        original.reset(termpaint_terminal_new_surface(f.terminal, 80, 24));
+        termpaint_surface_copy_rect(f.surface, 0, 0, 80, 24, original, 0, 0,
+                                    TERMPAINT_COPY_NO_TILE, TERMPAINT_COPY_NO_TILE);
+        dup.reset(termpaint_surface_duplicate(original));
+        original.reset();
+        checkEmptyPlusSome(dup, expected);
+    }
+}
+
+
+static std::vector<std::tuple<int, int, int, int>> collectDamage(termpaint_surface *surface) {
+    std::vector<termpaint_rect> rects;
+    rects.resize(termpaint_surface_damage_collect(surface, nullptr, 0));
+    REQUIRE(termpaint_surface_damage_collect(surface, rects.data(), rects.size()) == (int)rects.size());
+    std::vector<std::tuple<int, int, int, int>> ret;
+    for (const termpaint_rect &rect: rects) {
+        ret.emplace_back(rect.x, rect.y, rect.width, rect.height);
+    }
+    return ret;
+}
+
+
+TEST_CASE("damage tracking") {
+    Fixture f{80, 24};
+    using Rects = std::vector<std::tuple<int, int, int, int>>;
+
+    usurface_ptr s1;
+    s1.reset(termpaint_terminal_new_surface(f.terminal, 40, 10));
+    CHECK(collectDamage(s1) == Rects{{0, 0, 40, 10}});
+
+    termpaint_surface_damage_begin(s1);
+    CHECK(collectDamage(s1) == Rects{});
+
+    SECTION("write and reset") {
+        termpaint_surface_write_with_colors(s1, 3, 2, "Sample", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        termpaint_surface_set_fg_color(s1, 20, 5, TERMPAINT_COLOR_RED);
+        CHECK(collectDamage(s1) == Rects{{3, 2, 6, 1}, {20, 5, 1, 1}});
+
+        termpaint_surface_damage_reset(s1);
+        CHECK(collectDamage(s1) == Rects{});
+    }
+
+    SECTION("merged") {
+        termpaint_surface_clear_rect(s1, 5, 1, 10, 3, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        termpaint_surface_write_with_colors(s1, 6, 4, "Sample", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        termpaint_surface_write_with_colors(s1, 30, 5, "x", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        CHECK(collectDamage(s1) == Rects{{5, 1, 10, 4}, {30, 5, 1, 1}});
+    }
+
+    SECTION("view") {
+        usurface_ptr view;
+        view.reset(termpaint_surface_new_view(s1, 10, 2, 10, 5));
+        termpaint_surface_write_with_colors(s1, 0, 3, "Sample", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        CHECK(collectDamage(view) == Rects{});
+        termpaint_surface_write_with_colors(s1, 8, 4, "Sample", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        CHECK(collectDamage(view) == Rects{{0, 2, 4, 1}});
+
+        termpaint_surface_damage_reset(view);
+        CHECK(collectDamage(view) == Rects{});
+        CHECK(collectDamage(s1) == Rects{{0, 3, 6, 1}, {8, 4, 2, 1}});
+    }
+
+    SECTION("duplicate") {
+        usurface_ptr dup;
+        dup.reset(termpaint_surface_duplicate(s1));
+        termpaint_surface_damage_begin(dup);
+        termpaint_surface_write_with_colors(s1, 0, 0, "x", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        CHECK(collectDamage(dup) == Rects{});
+        termpaint_surface_write_with_colors(dup, 0, 1, "x", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        CHECK(collectDamage(dup) == Rects{{0, 1, 1, 1}});
+    }
+
+    SECTION("resize") {
+        termpaint_surface_resize(s1, 42, 11);
+        CHECK(collectDamage(s1) == Rects{{40, 0, 2, 10}, {0, 10, 42, 1}});
+    }
+}
+
+
 TEST_CASE("copy - simple") {
     Fixture f{80, 24};
 
@@ -2046,6 +2480,32 @@ TEST_CASE("copy - simple") {
 }
 
 
+TEST_CASE("copy - replaces patch") {
+    Fixture f{80, 24};
+
+    termpaint_attr* attr_url = termpaint_attr_new(TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_attr_set_patch(attr_url, true, "\033]8;;http://example.com\033\\", "\033]8;;\033\\");
+    termpaint_surface_clear_with_attr(f.surface, attr_url);
+    termpaint_attr_free(attr_url);
+
+    usurface_ptr s1;
+    s1.reset(termpaint_terminal_new_surface(f.terminal, 80, 24));
+    termpaint_surface_clear(s1, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_surface_write_with_colors(s1, 10, 3, "Sample", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+
+    termpaint_surface_copy_rect(s1, 0, 0, 80, 24, f.surface, 0, 0, TERMPAINT_COPY_NO_TILE, TERMPAINT_COPY_NO_TILE);
+
+    checkEmptyPlusSome(f.surface, {
+            {{ 10, 3 }, singleWideChar("S")},
+            {{ 11, 3 }, singleWideChar("a")},
+            {{ 12, 3 }, singleWideChar("m")},
+            {{ 13, 3 }, singleWideChar("p")},
+            {{ 14, 3 }, singleWideChar("l")},
+            {{ 15, 3 }, singleWideChar("e")},
+        });
+}
+
+
 TEST_CASE("copy - width == 0") {
     Fixture f{80, 24};
 
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: BSL-1.0
 #include <random>
 #include <string>
+#include <thread>
 
 #ifndef BUNDLED_CATCH2
 #ifdef CATCH3
@@ -14,3 +15,608 @@
 
 #include <termpaint.h>
 
+#include <termpaintx.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+namespace {
+
+struct PipeFixture {
+    PipeFixture() {
+        REQUIRE(pipe(fds) == 0);
+        REQUIRE(fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0);
+        integration = termpaintx_full_integration_from_fds(fds[0], fds[1], "");
+        terminal = termpaint_terminal_new(integration);
+        termpaint_terminal_set_event_cb(terminal, [](void *, termpaint_event *) {}, nullptr);
+        surface = termpaint_terminal_get_surface(terminal);
+        termpaint_surface_resize(surface, 80, 24);
+    }
+
+    ~PipeFixture() {
+        termpaint_terminal_free(terminal);
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    std::string drain() {
+        std::string ret;
+        char buf[4096];
+        ssize_t len;
+        while ((len = read(fds[0], buf, sizeof(buf))) > 0) {
+            ret.append(buf, len);
+        }
+        return ret;
+    }
+
+    int fds[2];
+    termpaint_integration *integration;
+    termpaint_terminal *terminal;
+    termpaint_surface *surface;
+};
+
+}
+
+TEST_CASE("termpaintx: output is buffered until flush") {
+    PipeFixture f;
+    termpaint_surface_write_with_colors(f.surface, 0, 0, "Hello World", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, true);
+    std::string output = f.drain();
+
+    int bytes = -1, syscalls = -1;
+    termpaintx_full_integration_last_flush_statistics(f.integration, &bytes, &syscalls);
+    CHECK(bytes == (int)output.size());
+    CHECK(syscalls == 1);
+    CHECK(output.find("Hello World") != std::string::npos);
+}
+
+TEST_CASE("termpaintx: output buffer size") {
+    PipeFixture f;
+    const int size = GENERATE(0, 1, 100);
+    REQUIRE(termpaintx_full_integration_set_output_buffer_size(f.integration, size));
+    termpaint_surface_write_with_colors(f.surface, 0, 0, "Hello World", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, true);
+    std::string output = f.drain();
+
+    int bytes = -1, syscalls = -1;
+    termpaintx_full_integration_last_flush_statistics(f.integration, &bytes, &syscalls);
+    CHECK(bytes == (int)output.size());
+    CHECK(syscalls > 1);
+    if (size == 100) {
+        CHECK(syscalls <= (bytes + 99) / 100 * 2);
+    }
+    CHECK(output.find("Hello World") != std::string::npos);
+
+    CHECK_FALSE(termpaintx_full_integration_set_output_buffer_size(f.integration, -1));
+}
+
+TEST_CASE("flush after resize only repaints changes") {
+    PipeFixture f;
+    termpaint_surface_write_with_colors(f.surface, 0, 0, "Kept", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, false);
+    CHECK(f.drain().find("Kept") != std::string::npos);
+
+    termpaint_surface_write_with_colors(f.surface, 0, 1, "Changed", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, false);
+    std::string output = f.drain();
+    CHECK(output.find("Kept") == std::string::npos);
+    CHECK(output.find("Changed") != std::string::npos);
+}
+
+TEST_CASE("unchanged rows with trailing erase are flushed like changed rows") {
+    PipeFixture f;
+    termpaint_terminal_promise_capability(f.terminal, TERMPAINT_CAPABILITY_CLEARED_COLORING);
+    termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_COLOR_BLUE);
+    termpaint_surface_write_with_colors(f.surface, 0, 0, "Text", TERMPAINT_DEFAULT_COLOR, TERMPAINT_COLOR_BLUE);
+    termpaint_terminal_flush(f.terminal, false);
+    CHECK(f.drain().find("\033[K") != std::string::npos);
+
+    termpaint_terminal_flush(f.terminal, false);
+    std::string output = f.drain();
+    CHECK(output.find("\033[K") != std::string::npos);
+    CHECK(output.find("Text") == std::string::npos);
+
+    // damage tracking does not change the output
+    termpaint_surface_write_with_colors(f.surface, 0, 0, "Text", TERMPAINT_DEFAULT_COLOR, TERMPAINT_COLOR_BLUE);
+    termpaint_terminal_flush(f.terminal, false);
+    CHECK(f.drain() == output);
+}
+
+TEST_CASE("termpaintx: non blocking output") {
+    PipeFixture f;
+    REQUIRE(fcntl(f.fds[1], F_SETFL, O_NONBLOCK) == 0);
+    termpaintx_full_integration_set_nonblocking_output(f.integration, true);
+
+    // fill pipe, so that output can not be written
+    std::string filler(4096, 'x');
+    while (write(f.fds[1], filler.data(), filler.size()) > 0) {
+    }
+
+    termpaint_surface_write_with_colors(f.surface, 0, 0, "Hello World", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, true);
+    CHECK(termpaintx_full_integration_poll_write_fd(f.integration) == f.fds[1]);
+    CHECK_FALSE(termpaintx_full_integration_resume_write(f.integration));
+
+    // write out everything
+    std::string output;
+    while (!termpaintx_full_integration_resume_write(f.integration)) {
+        output += f.drain();
+    }
+    output += f.drain();
+    CHECK(termpaintx_full_integration_poll_write_fd(f.integration) == -1);
+    CHECK(output.find("Hello World") != std::string::npos);
+
+    termpaint_surface_write_with_colors(f.surface, 0, 1, "Second", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, false);
+    CHECK(termpaintx_full_integration_poll_write_fd(f.integration) == -1);
+    CHECK(f.drain().find("Second") != std::string::npos);
+}
+
+TEST_CASE("termpaintx: disabling non blocking output writes queued output") {
+    PipeFixture f;
+    REQUIRE(fcntl(f.fds[1], F_SETFL, O_NONBLOCK) == 0);
+    termpaintx_full_integration_set_nonblocking_output(f.integration, true);
+
+    // fill pipe, so that output can not be written
+    std::string filler(4096, 'x');
+    while (write(f.fds[1], filler.data(), filler.size()) > 0) {
+    }
+
+    termpaint_surface_write_with_colors(f.surface, 0, 0, "Hello World", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, true);
+    REQUIRE(termpaintx_full_integration_poll_write_fd(f.integration) == f.fds[1]);
+
+    // the queued output does not fit into the pipe until this reads
+    std::string output;
+    std::thread reader([&] {
+        for (int i = 0; i < 500 && output.find("Hello World") == std::string::npos; i++) {
+            struct pollfd info;
+            info.fd = f.fds[0];
+            info.events = POLLIN;
+            poll(&info, 1, 10);
+            output += f.drain();
+        }
+    });
+    termpaintx_full_integration_set_nonblocking_output(f.integration, false);
+    reader.join();
+
+    CHECK(output.find("Hello World") != std::string::npos);
+    CHECK(termpaintx_full_integration_poll_write_fd(f.integration) == -1);
+    CHECK((fcntl(f.fds[1], F_GETFL) & O_NONBLOCK) == 0);
+
+    termpaint_surface_write_with_colors(f.surface, 0, 1, "Second", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, false);
+    CHECK(f.drain().find("Second") != std::string::npos);
+}
+
+TEST_CASE("flush with sgr delta encoding only emits changed attributes") {
+    PipeFixture f;
+    termpaint_terminal_flush(f.terminal, false);
+    f.drain();
+
+    termpaint_terminal_set_sgr_delta_encoding(f.terminal, true);
+    termpaint_attr *attr = termpaint_attr_new(TERMPAINT_COLOR_RED, TERMPAINT_DEFAULT_COLOR);
+    termpaint_attr_set_style(attr, TERMPAINT_STYLE_BOLD);
+    termpaint_surface_write_with_attr(f.surface, 0, 0, "A", attr);
+    termpaint_attr_unset_style(attr, TERMPAINT_STYLE_BOLD);
+    termpaint_surface_write_with_attr(f.surface, 1, 0, "B", attr);
+    termpaint_attr_free(attr);
+    termpaint_terminal_flush(f.terminal, false);
+    std::string output = f.drain();
+    CHECK(output.find("\033[0;31;1mA\033[22mB") != std::string::npos);
+
+    termpaint_terminal_set_sgr_delta_encoding(f.terminal, false);
+    termpaint_terminal_flush(f.terminal, true);
+    output = f.drain();
+    CHECK(output.find("\033[0;31;1mA\033[0;31mB") != std::string::npos);
+}
+
+TEST_CASE("flush budget leads to partial flushes") {
+    PipeFixture f;
+    for (int y = 0; y < 24; y++) {
+        termpaint_surface_write_with_colors(f.surface, 0, y, std::string(80, 'a' + y % 26).c_str(),
+                                            TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    }
+    termpaint_terminal_set_flush_budget(f.terminal, 500);
+    termpaint_terminal_flush(f.terminal, true);
+    CHECK(termpaint_terminal_last_flush_partial(f.terminal));
+    std::string output = f.drain();
+    CHECK(output.find(std::string(80, 'a')) != std::string::npos);
+    CHECK(output.find(std::string(80, 'x')) == std::string::npos);
+
+    int flushes = 1;
+    while (termpaint_terminal_last_flush_partial(f.terminal) && flushes < 24) {
+        termpaint_terminal_flush(f.terminal, false);
+        output += f.drain();
+        flushes++;
+    }
+    CHECK_FALSE(termpaint_terminal_last_flush_partial(f.terminal));
+    CHECK(flushes > 1);
+    for (int y = 0; y < 24; y++) {
+        CHECK(output.find(std::string(80, 'a' + y % 26)) != std::string::npos);
+    }
+
+    // everything was painted, nothing left to do
+    termpaint_terminal_flush(f.terminal, false);
+    CHECK_FALSE(termpaint_terminal_last_flush_partial(f.terminal));
+    CHECK(f.drain().find('a') == std::string::npos);
+}
+
+TEST_CASE("resize only repaints everything if needed") {
+    PipeFixture f;
+    termpaint_surface_write_with_colors(f.surface, 0, 0, "Kept", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, false);
+    CHECK(f.drain().find("Kept") != std::string::npos);
+
+    termpaint_surface_resize(f.surface, 100, 24);
+    termpaint_surface_write_with_colors(f.surface, 90, 0, "New", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, false);
+    std::string output = f.drain();
+    CHECK(output.find("Kept") == std::string::npos);
+    CHECK(output.find("New") != std::string::npos);
+
+    termpaint_surface_resize(f.surface, 100, 20);
+    termpaint_terminal_flush(f.terminal, false);
+    output = f.drain();
+    CHECK(output.find("Kept") != std::string::npos);
+    CHECK(output.find("New") != std::string::npos);
+}
+
+TEST_CASE("flush moves scrolled rows with a scroll region") {
+    PipeFixture f;
+    termpaint_terminal_promise_capability(f.terminal, TERMPAINT_CAPABILITY_SCROLL_REGION);
+    auto writeLines = [&](int y0, int y1, int first) {
+        for (int y = y0; y <= y1; y++) {
+            termpaint_surface_write_with_colors(f.surface, 0, y, ("Line " + std::to_string(first + y - y0) + " of the log").c_str(),
+                                                TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        }
+    };
+    termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    writeLines(0, 23, 100);
+    termpaint_terminal_flush(f.terminal, false);
+    f.drain();
+    termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+
+    SECTION("up") {
+        writeLines(0, 23, 101);
+        termpaint_terminal_flush(f.terminal, false);
+        std::string output = f.drain();
+        CHECK(output.find("\033[1;24r\033[1H\033[1M\033[r") != std::string::npos);
+        CHECK(output.find("Line 124") != std::string::npos);
+        CHECK(output.find("Line 110") == std::string::npos);
+    }
+
+    SECTION("down") {
+        writeLines(0, 23, 98);
+        termpaint_terminal_flush(f.terminal, false);
+        std::string output = f.drain();
+        CHECK(output.find("\033[1;24r\033[1H\033[2L\033[r") != std::string::npos);
+        CHECK(output.find("Line 98") != std::string::npos);
+        CHECK(output.find("Line 99") != std::string::npos);
+        CHECK(output.find("Line 110") == std::string::npos);
+    }
+
+    SECTION("partial region") {
+        writeLines(0, 4, 100);
+        writeLines(5, 12, 107);
+        writeLines(13, 14, 300);
+        writeLines(15, 23, 115);
+        termpaint_terminal_flush(f.terminal, false);
+        std::string output = f.drain();
+        CHECK(output.find("\033[6;15r\033[6H\033[2M\033[r") != std::string::npos);
+        CHECK(output.find("Line 300") != std::string::npos);
+        CHECK(output.find("Line 301") != std::string::npos);
+        CHECK(output.find("Line 102") == std::string::npos);
+        CHECK(output.find("Line 110") == std::string::npos);
+        CHECK(output.find("Line 120") == std::string::npos);
+    }
+
+    SECTION("no matching rows") {
+        for (int y = 0; y < 24; y++) {
+            termpaint_surface_write_with_colors(f.surface, 0, y, ("Other " + std::to_string(y)).c_str(),
+                                                TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        }
+        termpaint_terminal_flush(f.terminal, false);
+        std::string output = f.drain();
+        CHECK(output.find("\033[r") == std::string::npos);
+        CHECK(output.find("Other 10") != std::string::npos);
+    }
+
+    SECTION("unchanged") {
+        writeLines(0, 23, 100);
+        termpaint_terminal_flush(f.terminal, false);
+        CHECK(f.drain().find("\033[r") == std::string::npos);
+    }
+}
+
+TEST_CASE("flush uses REP and ECH for runs of identical cells") {
+    PipeFixture f;
+    termpaint_terminal_promise_capability(f.terminal, TERMPAINT_CAPABILITY_REPEAT_CHAR);
+    termpaint_terminal_promise_capability(f.terminal, TERMPAINT_CAPABILITY_CLEARED_COLORING);
+    termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_COLOR_BLUE);
+    termpaint_terminal_flush(f.terminal, false);
+    f.drain();
+
+    SECTION("repeated run") {
+        const std::string text = std::string(20, 'a') + "Z";
+        termpaint_surface_write_with_colors(f.surface, 0, 3, text.c_str(), TERMPAINT_DEFAULT_COLOR, TERMPAINT_COLOR_BLUE);
+        termpaint_terminal_flush(f.terminal, false);
+        CHECK(f.drain().find("a\033[19bZ") != std::string::npos);
+
+        // the repeated cells are recorded as painted
+        termpaint_surface_write_with_colors(f.surface, 0, 3, text.c_str(), TERMPAINT_DEFAULT_COLOR, TERMPAINT_COLOR_BLUE);
+        termpaint_terminal_flush(f.terminal, false);
+        std::string output = f.drain();
+        termpaint_terminal_flush(f.terminal, false);
+        CHECK(output == f.drain());
+    }
+
+    SECTION("erased run") {
+        termpaint_surface_clear_rect(f.surface, 0, 3, 17, 1, TERMPAINT_DEFAULT_COLOR, TERMPAINT_COLOR_GREEN);
+        termpaint_surface_write_with_colors(f.surface, 0, 3, "Start", TERMPAINT_DEFAULT_COLOR, TERMPAINT_COLOR_GREEN);
+        termpaint_surface_write_with_colors(f.surface, 14, 3, "End", TERMPAINT_DEFAULT_COLOR, TERMPAINT_COLOR_GREEN);
+        termpaint_terminal_flush(f.terminal, false);
+        // ECH does not move the cursor
+        CHECK(f.drain().find("Start\033[9X\033[9CEnd") != std::string::npos);
+
+        // the erased cells are recorded as painted
+        termpaint_surface_clear_rect(f.surface, 5, 3, 9, 1, TERMPAINT_DEFAULT_COLOR, TERMPAINT_COLOR_GREEN);
+        termpaint_terminal_flush(f.terminal, false);
+        std::string output = f.drain();
+        termpaint_terminal_flush(f.terminal, false);
+        CHECK(output == f.drain());
+    }
+
+    SECTION("run ending before trailing erase") {
+        termpaint_surface_write_with_colors(f.surface, 0, 3, std::string(10, 'a').c_str(), TERMPAINT_DEFAULT_COLOR, TERMPAINT_COLOR_RED);
+        termpaint_surface_clear_rect(f.surface, 10, 3, 70, 1, TERMPAINT_DEFAULT_COLOR, TERMPAINT_COLOR_RED);
+        termpaint_terminal_flush(f.terminal, false);
+        CHECK(f.drain().find("a\033[9b\033[K") != std::string::npos);
+    }
+}
+
+TEST_CASE("flush moves the cursor with the shortest sequence") {
+    PipeFixture f;
+    // otherwise every blank row repeats its trailing erase in each flush
+    termpaint_terminal_disable_capability(f.terminal, TERMPAINT_CAPABILITY_CLEARED_COLORING);
+    termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, false);
+    f.drain();
+
+    auto write = [&](int x, int y, const char *text) {
+        termpaint_surface_write_with_colors(f.surface, x, y, text, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    };
+
+    SECTION("first move") {
+        write(10, 5, "A");
+        termpaint_terminal_flush(f.terminal, false);
+        std::string output = f.drain();
+        CHECK(output.find("\033[6;11H\033[0mA") != std::string::npos);
+        CHECK(output.find("\033[H") == std::string::npos);
+    }
+
+    SECTION("CUF") {
+        write(10, 2, "A");
+        write(15, 2, "B");
+        termpaint_terminal_flush(f.terminal, false);
+        CHECK(f.drain().find("A\033[4CB") != std::string::npos);
+    }
+
+    SECTION("reprint") {
+        write(10, 2, "A");
+        write(13, 2, "B");
+        termpaint_terminal_flush(f.terminal, false);
+        CHECK(f.drain().find("A  B") != std::string::npos);
+    }
+
+    SECTION("CHA") {
+        write(10, 2, "A");
+        write(30, 2, "B");
+        termpaint_terminal_flush(f.terminal, false);
+        CHECK(f.drain().find("A\033[31GB") != std::string::npos);
+    }
+
+    SECTION("after the last column") {
+        write(79, 2, "A");
+        write(0, 3, "B");
+        termpaint_terminal_flush(f.terminal, false);
+        CHECK(f.drain().find("A\r\n\033[0mB") != std::string::npos);
+    }
+
+    SECTION("CUB") {
+        write(49, 11, "A");
+        write(48, 12, "B");
+        termpaint_terminal_flush(f.terminal, false);
+        CHECK(f.drain().find("A\033[B\033[2D\033[0mB") != std::string::npos);
+    }
+
+    SECTION("LF") {
+        write(0, 2, "A");
+        write(0, 4, "B");
+        termpaint_terminal_flush(f.terminal, false);
+        CHECK(f.drain().find("A\r\n\n\033[0mB") != std::string::npos);
+    }
+
+    SECTION("CUP") {
+        write(10, 2, "A");
+        write(5, 20, "B");
+        termpaint_terminal_flush(f.terminal, false);
+        CHECK(f.drain().find("A\033[21;6H\033[0mB") != std::string::npos);
+    }
+}
+
+TEST_CASE("flush moves the cursor up after resuming a partial flush") {
+    PipeFixture f;
+    termpaint_terminal_disable_capability(f.terminal, TERMPAINT_CAPABILITY_CLEARED_COLORING);
+    termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, false);
+    f.drain();
+
+    auto write = [&](int x, int y, const char *text) {
+        termpaint_surface_write_with_colors(f.surface, x, y, text, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    };
+
+    for (int y = 10; y <= 12; y++) {
+        write(0, y, std::string(70, 'a' + y).c_str());
+    }
+    termpaint_terminal_set_flush_budget(f.terminal, 100);
+    termpaint_terminal_flush(f.terminal, false);
+    REQUIRE(termpaint_terminal_last_flush_partial(f.terminal));
+    CHECK(f.drain().find(std::string(70, 'a' + 12)) == std::string::npos);
+    termpaint_terminal_set_flush_budget(f.terminal, 0);
+
+    // the resumed flush continues with row 12 and then wraps around to the rows above
+
+    SECTION("CUU") {
+        write(70, 9, "U");
+        termpaint_terminal_flush(f.terminal, false);
+        CHECK_FALSE(termpaint_terminal_last_flush_partial(f.terminal));
+        CHECK(f.drain().find(std::string(70, 'a' + 12) + "\033[3A\033[0mU") != std::string::npos);
+    }
+
+    SECTION("VPA") {
+        write(70, 0, "U");
+        termpaint_terminal_flush(f.terminal, false);
+        CHECK_FALSE(termpaint_terminal_last_flush_partial(f.terminal));
+        CHECK(f.drain().find(std::string(70, 'a' + 12) + "\033[d\033[0mU") != std::string::npos);
+    }
+}
+
+TEST_CASE("flush with swapped buffers") {
+    PipeFixture f;
+    termpaint_terminal_promise_capability(f.terminal, TERMPAINT_CAPABILITY_SCROLL_REGION);
+    // swapped buffers keep unquantized colors
+    termpaint_terminal_disable_capability(f.terminal, TERMPAINT_CAPABILITY_TRUECOLOR_MAYBE_SUPPORTED);
+    termpaint_terminal_disable_capability(f.terminal, TERMPAINT_CAPABILITY_TRUECOLOR_SUPPORTED);
+    termpaint_terminal_set_swap_buffers(f.terminal, true);
+    // with swapped buffers the surface contents are unspecified after flush, so every frame is drawn completely
+    auto draw = [&](int first, const char *status) {
+        termpaint_surface_clear(f.surface, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        termpaint_surface_write_with_colors(f.surface, 0, 0, status, TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+        for (int y = 1; y < 24; y++) {
+            termpaint_surface_write_with_colors(f.surface, 0, y, ("Row " + std::to_string(first + y)).c_str(),
+                                                TERMPAINT_DEFAULT_COLOR, TERMPAINT_RGB_COLOR(0x20, 0x40, 0x90));
+        }
+    };
+
+    // first flush copies instead of swapping
+    draw(100, "alpha");
+    termpaint_terminal_flush(f.terminal, false);
+    std::string output = f.drain();
+    CHECK(output.find("alpha") != std::string::npos);
+    CHECK(output.find("Row 105") != std::string::npos);
+
+    draw(100, "bravo");
+    termpaint_terminal_flush(f.terminal, false);
+    output = f.drain();
+    CHECK(output.find("bravo") != std::string::npos);
+    CHECK(output.find("Row") == std::string::npos);
+
+    draw(100, "delta");
+    termpaint_terminal_flush(f.terminal, false);
+    output = f.drain();
+    CHECK(output.find("delta") != std::string::npos);
+    CHECK(output.find("Row") == std::string::npos);
+
+    // scrolling changes the last flushed rows, so this flush copies again
+    draw(101, "delta");
+    termpaint_terminal_flush(f.terminal, false);
+    output = f.drain();
+    CHECK(output.find("\033[2;24r") != std::string::npos);
+    CHECK(output.find("Row 124") != std::string::npos);
+    CHECK(output.find("Row 110") == std::string::npos);
+    CHECK(output.find("delta") == std::string::npos);
+
+    draw(101, "xyzzy");
+    termpaint_terminal_flush(f.terminal, false);
+    output = f.drain();
+    CHECK(output.find("xyzzy") != std::string::npos);
+    CHECK(output.find("Row") == std::string::npos);
+
+    termpaint_terminal_set_swap_buffers(f.terminal, false);
+    draw(101, "alpha");
+    termpaint_terminal_flush(f.terminal, false);
+    output = f.drain();
+    CHECK(output.find("alpha") != std::string::npos);
+    CHECK(output.find("Row") == std::string::npos);
+
+    // without swapping the surface keeps its contents
+    termpaint_terminal_flush(f.terminal, false);
+    output = f.drain();
+    CHECK(output.find("alpha") == std::string::npos);
+    CHECK(output.find("Row") == std::string::npos);
+    int len, left, right;
+    const char *text = termpaint_surface_peek_text(f.surface, 0, 5, &len, &left, &right);
+    CHECK(std::string(text, len) == "R");
+}
+
+TEST_CASE("flush wraps output in synchronized updates if supported") {
+    PipeFixture f;
+    const std::string begin = "\033[?2026h";
+    const std::string end = "\033[?2026l";
+    auto wrapped = [&](const std::string &output) {
+        return output.size() > begin.size() + end.size()
+                && output.compare(0, begin.size(), begin) == 0
+                && output.compare(output.size() - end.size(), end.size(), end) == 0
+                && output.find(begin, 1) == std::string::npos
+                && output.find(end) == output.size() - end.size();
+    };
+
+    termpaint_surface_write_with_colors(f.surface, 0, 0, "Hello World", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, false);
+    std::string output = f.drain();
+    CHECK(output.find("Hello World") != std::string::npos);
+    CHECK(output.find(begin) == std::string::npos);
+    CHECK(output.find(end) == std::string::npos);
+
+    termpaint_terminal_promise_capability(f.terminal, TERMPAINT_CAPABILITY_SYNCHRONIZED_UPDATE);
+
+    termpaint_surface_write_with_colors(f.surface, 0, 1, "Second", TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, false);
+    output = f.drain();
+    CHECK(output.find("Second") != std::string::npos);
+    CHECK(wrapped(output));
+
+    // each partial flush is wrapped on its own
+    for (int y = 0; y < 24; y++) {
+        termpaint_surface_write_with_colors(f.surface, 0, y, std::string(80, 'a' + y % 26).c_str(),
+                                            TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    }
+    termpaint_terminal_set_flush_budget(f.terminal, 500);
+    termpaint_terminal_flush(f.terminal, false);
+    CHECK(termpaint_terminal_last_flush_partial(f.terminal));
+    CHECK(wrapped(f.drain()));
+    int flushes = 1;
+    while (termpaint_terminal_last_flush_partial(f.terminal) && flushes < 24) {
+        termpaint_terminal_flush(f.terminal, false);
+        CHECK(wrapped(f.drain()));
+        flushes++;
+    }
+    CHECK_FALSE(termpaint_terminal_last_flush_partial(f.terminal));
+}
+
+TEST_CASE("flush skips long runs of unchanged cells") {
+    PipeFixture f;
+    // otherwise every blank row repeats its trailing erase in each flush
+    termpaint_terminal_disable_capability(f.terminal, TERMPAINT_CAPABILITY_CLEARED_COLORING);
+    std::string text;
+    for (int i = 0; i < 80; i++) {
+        text += 'a' + i % 26;
+    }
+    termpaint_surface_write_with_colors(f.surface, 0, 5, text.c_str(), TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, false);
+    CHECK(f.drain().find(text) != std::string::npos);
+
+    // rewriting the row marks all of it as changed, but only one cell differs
+    text[70] = 'Z';
+    termpaint_surface_write_with_colors(f.surface, 0, 5, text.c_str(), TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, false);
+    std::string output = f.drain();
+    CHECK(output.find("\033[6;71H\033[0mZ\033[") != std::string::npos);
+    CHECK(output.find("abc") == std::string::npos);
+
+    termpaint_surface_write_with_colors(f.surface, 0, 5, text.c_str(), TERMPAINT_DEFAULT_COLOR, TERMPAINT_DEFAULT_COLOR);
+    termpaint_terminal_flush(f.terminal, false);
+    CHECK(f.drain().find('Z') == std::string::npos);
+}